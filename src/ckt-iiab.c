@@ -26,19 +26,23 @@ LICENSE:
 #include <util/delay.h>
 #include <util/atomic.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 
+#include "hal.h"
 #include "io.h"
 #include "interlocking.h"
 #include "debouncer.h"
 #include "signalHead.h"
-
-typedef enum
-{
-	DELAY_PCNT_NONE = 0,
-	DELAY_PCNT_LOW,
-	DELAY_PCNT_MID,
-	DELAY_PCNT_HIGH,
-} DelayPcnt;
+#include "timers.h"
+#include "delay.h"
+#include "prng.h"
+#include "trace.h"
+#include "eventLog.h"
+#include "stats.h"
+#include "telemetry.h"
+#ifdef LINK_ENABLE
+#include "link.h"
+#endif
 
 #define OPPOSITE_DIRECTION(d) (((d)==APPROACH_A)?APPROACH_B:APPROACH_A)
 
@@ -56,83 +60,259 @@ typedef enum
 } InterlockState;
 
 uint32_t timeoutSeconds;
-volatile uint32_t timeoutTimer;
-
 uint32_t lockoutSeconds;
-volatile uint32_t lockoutTimer;
-
 uint32_t delaySeconds;
-volatile uint32_t delayTimer;
 volatile uint32_t millis = 0;
 
-SignalState_t signalA;
-SignalState_t signalB;
-volatile uint8_t signalHeadOptions;
+// Express mode (EXPRESS_ENABLE builds, fixed delay, DIP set to 0) clears an approach without any delay
+//  and with a short crossfade.  The time from the approach detector first
+//  showing up to the signal being cleared is recorded; the lamp itself lights
+//  on the next frame, up to EXPRESS_LAMP_MS later.
+#define EXPRESS_BUDGET_MS   25
+#define EXPRESS_LAMP_MS     9
 
-// Signal Port Connections
-// These are in the order of:
-//  Red address, bitmask
-//  Yellow address, bitmask
-//  Green address, bitmask
+uint16_t expressLatencyLast = 0;
+uint16_t expressLatencyMax = 0;
+uint16_t expressBudgetMisses = 0;
 
-#define SIGNAL_HEAD_A_DEF   &PORTB, _BV(PB0), &PORTB, 0, &PORTB, _BV(PB1)
-#define SIGNAL_HEAD_B_DEF   &PORTB, _BV(PB2), &PORTB, 0, &PORTB, _BV(PB3)
+// Signal heads
+// Each head is an entry in signalHeadDefs, a PROGMEM table of the port table
+//  byte its lamps are on, the red, yellow, green and lunar masks, and its type
+//  (SIGNAL_TYPE_*, signalHead.h).  Lamps are on HAL_SIGNAL_PORT (PORTB) unless
+//  built with SIGNAL_OUTPUT_SHIFT_REGISTERS.  The interlocking only runs heads
+//  A and B, but any more in the table are stepped and dimmed along with them.
 
-ISR(TIMER0_COMPA_vect) 
+#define SIGNAL_HEAD_A       0
+#define SIGNAL_HEAD_B       1
+
+static const SignalHeadDef_t signalHeadDefs[] PROGMEM =
+{
+#if defined(SIGNAL_OUTPUT_SHIFT_REGISTERS)
+	// Through the 74HC595s (hal.h) every lamp gets an output: QA - QC and QG
+	//  of the first chip for A, QD - QF and QH for B.  Heads on the rest of
+	//  the chain go on the end.
+	{ 0, 0x01, 0x02, 0x04, 0x40, SIGNAL_TYPE_JUMPER },
+	{ 0, 0x08, 0x10, 0x20, 0x80, SIGNAL_TYPE_JUMPER },
+#elif defined(SIGNAL_PWM_TIMER1)
+	// Greens are on OC1A (PB1) and OC1B (PB3) and are dimmed by Timer1.  Reds are on
+	//  the complementary /OC1A and /OC1B pins, which can't be used on their own, so
+	//  they stay on the software PWM.  The table holds the green pins at their off
+	//  level for whenever the timer output is disconnected.
+	{ 0, _BV(PB0), 0, 0, 0, SIGNAL_TYPE_JUMPER },
+	{ 0, _BV(PB2), 0, 0, 0, SIGNAL_TYPE_JUMPER },
+#define SIGNAL_HW_PWM_PINS  (_BV(PB1) | _BV(PB3))
+#else
+	{ 0, _BV(PB0), 0, _BV(PB1), 0, SIGNAL_TYPE_JUMPER },
+	{ 0, _BV(PB2), 0, _BV(PB3), 0, SIGNAL_TYPE_JUMPER },
+#endif
+};
+
+#define SIGNAL_HEADS        (sizeof(signalHeadDefs) / sizeof(signalHeadDefs[0]))
+
+// Whatever else is on the port is carried through the table untouched
+#ifdef SIGNAL_OUTPUT_SHIFT_REGISTERS
+#define SIGNAL_PORT_BASE    0
+#else
+#define SIGNAL_PORT_BASE    HAL_SIGNAL_PORT
+#endif
+
+SignalState_t signalHeads[SIGNAL_HEADS];
+SignalPortTable_t signalPortTable;
+volatile uint8_t signalHeadOptions;
+
+static inline void millisTick(void)
+{
+	// Timers are deadlines against millis, checked from the main loop
+	millis++;
+}
+
+static inline void signalFrameUpdate(void)
 {
 	static uint8_t flasherCounter = 0;
 	static uint8_t flasher = 0;
-	static uint8_t pwmPhase = 0;
-	static uint8_t subMillisCounter = 0;
-	
+
+	flasherCounter++;
+	if (flasherCounter > 94)
+	{
+		flasher ^= 0x01;
+		flasherCounter = 0;
+	}
+
+	// Calculate the next PWM widths and turn them into port values
+	// This runs at 125 frames/second essentially
+
+	signalHeadISR_PortTableBegin(&signalPortTable);
+	signalHeadISR_HeadsToPortTable(signalHeads, signalHeadDefs, SIGNAL_HEADS, &signalPortTable, flasher, signalHeadOptions);
+#ifdef SIGNAL_PWM_TIMER1
+	signalHeadISR_LampsOffToPortTable(&signalPortTable, 0, SIGNAL_HW_PWM_PINS);
+	halHardwarePWMSet(HAL_HW_PWM_OC1A, signalHeadPWMToHardware(signalHeads[SIGNAL_HEAD_A].greenPWM), signalHeadOptions & SIGNAL_OPTION_COMMON_ANODE);
+	halHardwarePWMSet(HAL_HW_PWM_OC1B, signalHeadPWMToHardware(signalHeads[SIGNAL_HEAD_B].greenPWM), signalHeadOptions & SIGNAL_OPTION_COMMON_ANODE);
+#endif
+	signalHeadISR_PortTableEnd(&signalPortTable, signalHeadOptions, SIGNAL_PORT_BASE);
+}
+
+// PWM gating
+// When every head is steady (full on or off, not flashing, nothing pending), the
+//  PWM interrupt has nothing to do.  The lamps get latched on the port and the
+//  timer drops to a 1ms tick that only keeps millis, until signalHeadAspectSet()
+//  asks for a change.
+
+static uint8_t signalPWMIdle = 0;
+
+static inline bool signalHeadsSteady(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < SIGNAL_HEADS; i++)
+		if (!signalHeadIsSteady(&signalHeads[i]))
+			return false;
+	return true;
+}
+
+static inline void signalPWMSleep(void)
+{
+	// Steady lamps are full on or off, and every "on" lamp is lit in the first phase
+	halSignalOutput(signalPortTable.phase[0]);
+	signalHeadsChanged = false;
+	signalPWMIdle = 1;
+	halTimerPWMIdle(true);
+}
+
+#ifdef SIGNAL_PWM_BAM
+
+// Bit Angle Modulation
+// Timer0 free-runs at 8MHz / 64.  Compare A steps through the five PWM bits,
+//  holding each bit's lamps for 1, 2, 4, 8 and 16 units, so a frame is only
+//  five interrupts.  Compare B is an independent 1ms timebase for millis.
+// With 16 counts (128us) per unit, a frame is 3.968ms - about 252 frames/second.
+
+#define BAM_UNIT_COUNTS   16
+
+static volatile uint8_t signalFrameDue = 0;
+static uint8_t bamBit = 0;
+
+ISR(TIMER0_COMPA_vect)
+{
+	TELEMETRY_ISR_BEGIN();
+	halSignalOutput(signalPortTable.phase[bamBit]);
+	halTimerPWMAdvance((uint8_t)(BAM_UNIT_COUNTS << bamBit));  // 16 units wraps to 0, a full 256 counts
+
+	if (++bamBit >= SIGNAL_PWM_PHASES)
+	{
+		bamBit = 0;
+
+		// The longest bit was just started, leaving ~2ms before the next interrupt.
+		// That's plenty of time to work out the next frame without disturbing this one.
+		if (signalFrameDue)
+		{
+			signalFrameDue = 0;
+			signalFrameUpdate();
+			if (signalHeadsSteady())
+				signalPWMSleep();  // Turns off compare A, compare B keeps running
+		}
+
+		// Still well inside the long bit, so the status LED fits here too
+		statusLedISR_Transmit();
+	}
+	TELEMETRY_ISR_END(8);
+}
+
+ISR(TIMER0_COMPB_vect)
+{
+	static uint8_t frameMillis = 0;
+
+	TELEMETRY_ISR_BEGIN();
+	halTimerTickAdvance();
+	millisTick();
+
+	if (signalPWMIdle)
+	{
+		// Compare A is off, so the status LED is sent from here
+		statusLedISR_Transmit();
+		if (signalHeadsChanged)
+		{
+			// Start over at the first bit of a new frame
+			signalPWMIdle = 0;
+			bamBit = 0;
+			signalFrameDue = 1;
+			halTimerPWMIdle(false);
+		}
+		TELEMETRY_ISR_END(8);
+		return;
+	}
+
+	// Signal animations (fades, flashing) are still stepped at 125 Hz
+	if (++frameMillis >= 8)
+	{
+		frameMillis = 0;
+		signalFrameDue = 1;
+	}
+	TELEMETRY_ISR_END(8);
+}
+
+#else
+
+static uint8_t pwmPhase = 0;
+static uint8_t subMillisCounter = 0;
+
+ISR(TIMER0_COMPA_vect) 
+{
+	TELEMETRY_ISR_BEGIN();
+	if (signalPWMIdle)
+	{
+		// Lamps are latched and the timer is at 1kHz, just keep time
+		millisTick();
+		statusLedISR_Transmit();
+		if (signalHeadsChanged)
+		{
+			// Start the first frame right away rather than one frame later
+			signalPWMIdle = 0;
+			pwmPhase = subMillisCounter = 0;
+			halTimerPWMIdle(false);
+			signalFrameUpdate();
+		}
+		TELEMETRY_ISR_END(8);  // 1:64 prescaler while idle
+		return;
+	}
+
 	// The ISR does two main things - updates the LED outputs since
 	//  PWM is done through software, and updates millis which is used
 	//  to trigger various events
 	// We need this to run at roughly 125 Hz * number of PWM levels (32).  That makes a nice round 4kHz
 	
 	// First thing, output the signals so that the PWM doesn't get too much jitter
+	// The port values for every phase were worked out at the start of the frame
 
-	signalHeadISR_OutputPWM(&signalA, signalHeadOptions, pwmPhase, SIGNAL_HEAD_A_DEF);
-	signalHeadISR_OutputPWM(&signalB, signalHeadOptions, pwmPhase, SIGNAL_HEAD_B_DEF);
+	halSignalOutput(signalPortTable.phase[pwmPhase]);
 
 	// Now do all the counter incrementing and such
 	// This will run every millisecond since the timer is running at 4kHz
 	if (++subMillisCounter >= 4)
 	{
 		subMillisCounter = 0;
-		millis++;
-
-		if(lockoutTimer)
-			lockoutTimer--;
-		
-		if(timeoutTimer)
-			timeoutTimer--;
-		
-		if(delayTimer)
-			delayTimer--;
-
+		millisTick();
 	}
 
 	pwmPhase = (pwmPhase + 1) & 0x1F;
 
 	if (0 == pwmPhase)
 	{
-		pwmPhase = 0;
-		flasherCounter++;
-		if (flasherCounter > 94)
-		{
-			flasher ^= 0x01;
-			flasherCounter = 0;
-		}
-
-		// We rolled over the PWM counter, calculate the next PWM widths
-		// This runs at 125 frames/second essentially
-
-		signalHeadISR_AspectToNextPWM(&signalA, flasher, signalHeadOptions);
-		signalHeadISR_AspectToNextPWM(&signalB, flasher, signalHeadOptions);
+		// We rolled over the PWM counter, calculate the next frame
+		signalFrameUpdate();
+		if (signalHeadsSteady())
+			signalPWMSleep();
 	}
+	else
+	{
+		// Leave the frame calculation interrupt alone, any other one has
+		//  plenty of room before the next phase for the status LED
+		statusLedISR_Transmit();
+	}
+	TELEMETRY_ISR_END(1);
 }
 
+#endif
+
 uint32_t getMillis()
 {
 	uint32_t retmillis;
@@ -144,48 +324,75 @@ uint32_t getMillis()
 	return retmillis;
 }
 
+// Microseconds, for timestamping input edges.  Good to the Timer0 count
+//  (1us, or 8us while the PWM is idle or with BAM) and wraps every 71
+//  minutes.  The 4kHz PWM tick is 251us, so those ticks are held to the
+//  millisecond they're in to keep the time from stepping back.
+uint32_t getMicros(void)
+{
+	uint32_t ms;
+	uint16_t us;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		ms = millis;
+		us = halMicrosSinceTick();
+#ifndef SIGNAL_PWM_BAM
+		if (!signalPWMIdle)
+		{
+			us += subMillisCounter * (HAL_TICK_COUNTS + 1);
+			if (us > 999)
+				us = 999;
+		}
+#endif
+	}
+
+	return ms * 1000 + us;
+}
+
 void initializeTimer()
 {
-	TIMSK = 0;                                    // Timer interrupts OFF
-	// Set up Timer/Counter0 for 100Hz clock
-	TCCR0A = 0b00000001;  // CTC Mode
-	TCCR0B = 0b00000010;  // CS01 - 1:8 prescaler
-	OCR0A = 250;           // 8MHz / 8 / 125 = 8kHz
-	TIMSK = _BV(OCIE0A);
+	halInitializeTimer();
 }
 
 void init(void)
 {
-	// Kill watchdog
-	MCUSR = 0;
-	wdt_reset();
-	WDTCR = _BV(WDE) | _BV(WDP2) | _BV(WDP1);   // Enable WDT (1s)
-	wdt_reset();
+	uint8_t i;
 
+	// Watchdog, port directions and pull-ups
+	halInitialize();
+	traceInitialize();
 
-	PORTA = 0x0F;  // Pull-ups on PA0 - PA3
-	DDRA = _BV(PA7);  // Aux LED output
-	PORTB = 0x70;  // Pull-ups on PB4 - PB6
-	DDRB = _BV(PB0) | _BV(PB1) | _BV(PB2) | _BV(PB3);
+	signalHeadPortTableInitialize(&signalPortTable, SIGNAL_PORT_BASE);
 
 	initializeTimer();
+#ifdef SIGNAL_PWM_TIMER1
+	halInitializeHardwarePWM();
+#endif
 
 	initializeInputOutput();
+	prngSeed(halEntropy());
+	eventLogInitialize();
+	statsInitialize(halResetCause());
 
-	signalHeadInitialize(&signalA);
-	signalHeadInitialize(&signalB);
+#ifdef LINK_ENABLE
+	halLinkInitialize();
+	linkInitialize(halLinkNode());
+#endif
+	telemetryInitialize();
 
-	signalHeadAspectSet(&signalA, ASPECT_RED);
-	signalHeadAspectSet(&signalB, ASPECT_RED);
+	for (i = 0; i < SIGNAL_HEADS; i++)
+	{
+		signalHeadInitialize(&signalHeads[i]);
+		signalHeadAspectSet(&signalHeads[i], ASPECT_RED);
+	}
 
 	sei();
 	wdt_reset();
 
-	timeoutTimer = 0;
+	timersInitialize();
 	timeoutSeconds = 0;
-	lockoutTimer = 0;
 	lockoutSeconds = 0;
-	delayTimer = 0;
 	delaySeconds = 0;
 }
 
@@ -193,12 +400,13 @@ void init(void)
 int main(void)
 {
 	Block dir = NONE;
-	uint32_t temp_uint32;
-	uint32_t delayMin, delayMax;
-	DelayPcnt delayPcnt;
 	InterlockState state = STATE_IDLE;
 	bool first = true;
 	uint8_t dipSetting, oldDipSetting;
+	InterlockState tracedState = state;
+	EventLogEntry_t cycle;
+	uint32_t cycleStart = 0, cycleOccupied = 0, requestStart = 0;
+	uint8_t tracedAspects = 0;
 	
 	// Application initialization
 	init();
@@ -214,25 +422,25 @@ int main(void)
 	_delay_ms(200);
 	wdt_reset();
 	
-	signalHeadAspectSet(&signalA, ASPECT_GREEN);
+	signalHeadAspectSet(&signalHeads[SIGNAL_HEAD_A], ASPECT_GREEN);
 	readInputs();
 	readDipSwitches();
 	_delay_ms(300);
 	wdt_reset();
 
-	signalHeadAspectSet(&signalA, ASPECT_RED);
+	signalHeadAspectSet(&signalHeads[SIGNAL_HEAD_A], ASPECT_RED);
 	readInputs();
 	readDipSwitches();
 	_delay_ms(300);
 	wdt_reset();
 	
-	signalHeadAspectSet(&signalB, ASPECT_GREEN);
+	signalHeadAspectSet(&signalHeads[SIGNAL_HEAD_B], ASPECT_GREEN);
 	readInputs();
 	readDipSwitches();
 	_delay_ms(300);
 	wdt_reset();
 
-	signalHeadAspectSet(&signalB, ASPECT_RED);
+	signalHeadAspectSet(&signalHeads[SIGNAL_HEAD_B], ASPECT_RED);
 	readInputs();
 	readDipSwitches();
 	_delay_ms(300);
@@ -278,7 +486,8 @@ int main(void)
 		readInputs();
 		readDipSwitches();
 
-		signalHeadOptions = (isCommonAnode()?SIGNAL_OPTION_COMMON_ANODE:0) | (isSearchlight()?SIGNAL_OPTION_SEARCHLIGHT:0); 
+		signalHeadOptions = (isCommonAnode()?SIGNAL_OPTION_COMMON_ANODE:0) | (isSearchlight()?SIGNAL_OPTION_SEARCHLIGHT:0) | (isExpress()?SIGNAL_OPTION_EXPRESS:0); 
+		setExpressInputs(isExpress());
 
 		timeoutSeconds = 15 + (getTimeoutSetting() * 15);  // 15, 30, 45, 60s
 		lockoutSeconds = timeoutSeconds;
@@ -286,6 +495,13 @@ int main(void)
 		wdt_reset();
 
 		uint32_t tempMillis = getMillis();
+		timersUpdate(tempMillis);
+		eventLogUpdate();
+		statsUpdate(tempMillis);
+#ifdef LINK_ENABLE
+		linkUpdate(tempMillis);
+#endif
+
 		switch(state)
 		{
 			case STATE_IDLE:
@@ -301,11 +517,11 @@ int main(void)
 					oldDipSetting = dipSetting;
 				}
 				
-				if( approachBlockOccupancy(APPROACH_A) && !lockoutTimer )
+				if( approachBlockOccupancy(APPROACH_A) && !timerRunning(TIMER_LOCKOUT) )
 				{
 					dir = APPROACH_A;
 				}
-				else if( approachBlockOccupancy(APPROACH_B) && !lockoutTimer )
+				else if( approachBlockOccupancy(APPROACH_B) && !timerRunning(TIMER_LOCKOUT) )
 				{
 					dir = APPROACH_B;
 				}
@@ -314,147 +530,43 @@ int main(void)
 				{
 					if(first)
 					{
-						srandom(getMillis());  // Seed the random generator
+						prngMix(getMillis());  // The first train's timing is as random as it gets
 						first = false;
 					}
 
-					uint8_t delaySetting = getDelaySetting();
-					if(isRandomized())
+					delaySeconds = delaySelectSeconds(getDelaySetting(), isRandomized());
+
+					// Start of the cycle that goes in the event log
+					cycle.direction = dir;
+					cycle.outcome = EVENT_OUTCOME_TIMEOUT;
+					cycle.randomized = isRandomized();
+					cycle.express = isExpress();
+					cycle.delaySeconds = delaySeconds;
+					cycle.clearSeconds = cycle.occupiedSeconds = 0;
+					cycleStart = tempMillis;
+					statsTrain(dir, getDelaySetting(), isRandomized(), delaySeconds);
+
+					if(isExpress())
 					{
-						// Do something random
-						delayMin = 0;
-						delayMax = 0;
-						delayPcnt = DELAY_PCNT_NONE;
-						switch(delaySetting)
-						{
-							// Simple Ranges
-							case 0:
-								delayMin = 0;
-								delayMax = 10;
-								break;
-							case 1:
-								delayMin = 5;
-								delayMax = 20;
-								break;
-							case 2:
-								delayMin = 15;
-								delayMax = 30;
-								break;
-							case 3:
-								delayMin = 30;
-								delayMax = 60;
-								break;
-							// Bimodal range 15-30s
-							case 4:
-								delayMin = 15;
-								delayMax = 30;
-								delayPcnt = DELAY_PCNT_LOW;
-								break;
-							case 5:
-								delayMin = 15;
-								delayMax = 30;
-								delayPcnt = DELAY_PCNT_MID;
-								break;
-							case 6:
-								delayMin = 15;
-								delayMax = 30;
-								delayPcnt = DELAY_PCNT_HIGH;
-								break;
-							// Bimodal range 30-60s
-							case 7:
-								delayMin = 30;
-								delayMax = 60;
-								delayPcnt = DELAY_PCNT_LOW;
-								break;
-							case 8:
-								delayMin = 30;
-								delayMax = 60;
-								delayPcnt = DELAY_PCNT_MID;
-								break;
-							case 9:
-								delayMin = 30;
-								delayMax = 60;
-								delayPcnt = DELAY_PCNT_HIGH;
-								break;
-							// Bimodal range 60-120s
-							case 10:
-								delayMin = 60;
-								delayMax = 120;
-								delayPcnt = DELAY_PCNT_LOW;
-								break;
-							case 11:
-								delayMin = 60;
-								delayMax = 120;
-								delayPcnt = DELAY_PCNT_MID;
-								break;
-							case 12:
-								delayMin = 60;
-								delayMax = 120;
-								delayPcnt = DELAY_PCNT_HIGH;
-								break;
-							// Bimodal range 180-300s
-							case 13:
-								delayMin = 180;
-								delayMax = 300;
-								delayPcnt = DELAY_PCNT_LOW;
-								break;
-							case 14:
-								delayMin = 180;
-								delayMax = 300;
-								delayPcnt = DELAY_PCNT_MID;
-								break;
-							case 15:
-								delayMin = 180;
-								delayMax = 300;
-								delayPcnt = DELAY_PCNT_HIGH;
-								break;
-						}
-						// https://c-faq.com/lib/randrange.html
-						if( (DELAY_PCNT_LOW == delayPcnt) && (random() < ((uint32_t)RANDOM_MAX+1u) / 10 * 9) )
-						{
-							// No delay 90% of the time
-							delaySeconds = 1;  // Some minimal delay
-						}
-						else if( (DELAY_PCNT_MID == delayPcnt) && (random() < ((uint32_t)RANDOM_MAX+1u) / 10 * 7) )
-						{
-							// No delay 70% of the time
-							delaySeconds = 1;  // Some minimal delay
-						}
-						else if( (DELAY_PCNT_HIGH == delayPcnt) && (random() < ((uint32_t)RANDOM_MAX+1u) / 4) )
-						{
-							// No delay 25% of the time
-							delaySeconds = 1;  // Some minimal delay
-						}
-						else
-						{
-							delaySeconds = delayMin + random() / (RANDOM_MAX / (delayMax - delayMin + 1) + 1);
-						}
+						// No delay to wait out, go straight for the interlocking
+						state = STATE_REQUEST;
+						requestStart = tempMillis;
 					}
 					else
 					{
-						// Fixed delays
-						delaySeconds = delaySetting * 5;
+						timerStart(TIMER_DELAY, 1000 * delaySeconds);
+						state = STATE_DELAY;
 					}
-
-					ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
-					{
-						delayTimer = 1000 * delaySeconds;
-					}
-					state = STATE_DELAY;
 				}
 				break;
 
 			case STATE_DELAY:
 				setStatusLed(STATUS_YELLOW);
-				ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
-				{
-					temp_uint32 = delayTimer;
-				}
-
-				if(!temp_uint32)
+				if(!timerRunning(TIMER_DELAY))
 				{
 					// Delay expired.  Continue.
 					state = STATE_REQUEST;
+					requestStart = tempMillis;
 				}
 				break;
 
@@ -470,6 +582,18 @@ int main(void)
 				{
 					// Request for interlocking approved
 					state = STATE_CLEARANCE;
+					cycle.clearSeconds = (tempMillis - cycleStart) / 1000;
+					statsRequestWait(tempMillis - requestStart);
+
+					if(isExpress())
+					{
+						uint32_t latency = (getMicros() - getApproachAssertMicros(dir)) / 1000;
+						expressLatencyLast = (latency > 0xFFFF) ? 0xFFFF : latency;
+						if(expressLatencyLast > expressLatencyMax)
+							expressLatencyMax = expressLatencyLast;
+						if((expressLatencyLast + EXPRESS_LAMP_MS > EXPRESS_BUDGET_MS) && (expressBudgetMisses < 0xFFFF))
+							expressBudgetMisses++;
+					}
 				}
 				break;
 
@@ -479,14 +603,12 @@ int main(void)
 				{
 					// Train has entered interlocking, proceed
 					state = STATE_OCCUPIED;
+					cycleOccupied = tempMillis;
 				}
 				else if(!approachBlockOccupancy(dir))
 				{
 					// No occupany in approach block, start timeout
-					ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
-					{
-						timeoutTimer = 1000 * timeoutSeconds;
-					}
+					timerStart(TIMER_TIMEOUT, 1000 * timeoutSeconds);
 					state = STATE_TIMEOUT;
 				}
 				// Wait here if no exit conditions met
@@ -494,26 +616,23 @@ int main(void)
 
 			case STATE_TIMEOUT:
 				setStatusLed(STATUS_WHITE);
-				ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
-				{
-					temp_uint32 = timeoutTimer;
-				}
-
 				// Give priority to occupancy then timeout
 				if(interlockingBlockOccupancy())
 				{
 					// Train has entered interlocking, proceed
 					state = STATE_OCCUPIED;
+					cycleOccupied = tempMillis;
 				}
 				else if(approachBlockOccupancy(dir))
 				{
 					// Approach detector covered again, go back
 					state = STATE_CLEARANCE;
 				}
-				else if(!temp_uint32)
+				else if(!timerRunning(TIMER_TIMEOUT))
 				{
 					// Timed out.  Reset
 					state = STATE_RESET;
+					statsTimeout();
 				}
 				break;
 
@@ -522,27 +641,23 @@ int main(void)
 				if(!interlockingBlockOccupancy())
 				{
 					// Interlocking block is clear, start lockout timer
-					ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
-					{
-						lockoutTimer = 1000 * lockoutSeconds;
-					}
+					timerStart(TIMER_LOCKOUT, 1000 * lockoutSeconds);
 					state = STATE_LOCKOUT;
+					cycle.outcome = EVENT_OUTCOME_LOCKOUT;
+					cycle.occupiedSeconds = (tempMillis - cycleOccupied) / 1000;
 				}
 				else if(approachBlockOccupancy(OPPOSITE_DIRECTION(dir)))
 				{
 					// Opposite approach occupied
 					state = STATE_CLEARING;
+					cycle.outcome = EVENT_OUTCOME_CLEARED;
+					statsClearing();
 				}
 				break;
 
 			case STATE_LOCKOUT:
 				setStatusLed(STATUS_BLUE);
-				ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
-				{
-					temp_uint32 = lockoutTimer;
-				}
-
-				if(!temp_uint32)
+				if(!timerRunning(TIMER_LOCKOUT))
 				{
 					// Timed out.  Reset
 					state = STATE_RESET;
@@ -555,11 +670,13 @@ int main(void)
 				{
 					// Opposite approach and interlocking cleared
 					state = STATE_RESET;
+					cycle.occupiedSeconds = (tempMillis - cycleOccupied) / 1000;
 				}
 				break;
 
 			case STATE_RESET:
-				clearInterlocking();
+				eventLogRecord(&cycle, tempMillis);
+				releaseInterlocking(dir);
 				dir = NONE;
 				state = STATE_IDLE;
 				break;
@@ -572,22 +689,36 @@ int main(void)
 			case STATE_TIMEOUT:
 				if(APPROACH_A == dir)
 				{
-					signalHeadAspectSet(&signalA, ASPECT_GREEN);
-					signalHeadAspectSet(&signalB, ASPECT_RED);
+					signalHeadAspectSet(&signalHeads[SIGNAL_HEAD_A], ASPECT_GREEN);
+					signalHeadAspectSet(&signalHeads[SIGNAL_HEAD_B], ASPECT_RED);
 				}
 				else if(APPROACH_B == dir)
 				{
-					signalHeadAspectSet(&signalA, ASPECT_RED);
-					signalHeadAspectSet(&signalB, ASPECT_GREEN);
+					signalHeadAspectSet(&signalHeads[SIGNAL_HEAD_A], ASPECT_RED);
+					signalHeadAspectSet(&signalHeads[SIGNAL_HEAD_B], ASPECT_GREEN);
 				}
 				break;
 			default:
 				// Default to most restrictive aspect
-				signalHeadAspectSet(&signalA, ASPECT_RED);
-				signalHeadAspectSet(&signalB, ASPECT_RED);
+				signalHeadAspectSet(&signalHeads[SIGNAL_HEAD_A], ASPECT_RED);
+				signalHeadAspectSet(&signalHeads[SIGNAL_HEAD_B], ASPECT_RED);
 				break;
 		}
 
+		telemetryUpdate(tempMillis, state, dir);
+
+		if(state != tracedState)
+		{
+			traceEvent(TRACE_STATE, (dir << 4) | state);
+			tracedState = state;
+		}
+		uint8_t aspects = (signalHeadAspectGet(&signalHeads[SIGNAL_HEAD_A]) << 4) | signalHeadAspectGet(&signalHeads[SIGNAL_HEAD_B]);
+		if(aspects != tracedAspects)
+		{
+			traceEvent(TRACE_ASPECT, aspects);
+			tracedAspects = aspects;
+		}
+
 		wdt_reset();
 
 	}
@@ -0,0 +1,43 @@
+/*************************************************************************
+Title:    CKT-IIAB CRC-8
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     crc8.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdint.h>
+#include "crc8.h"
+
+uint8_t crc8Update(uint8_t crc, uint8_t data)
+{
+	uint8_t i;
+
+	crc ^= data;
+	for (i = 0; i < 8; i++)
+		crc = (crc & 0x80) ? (crc << 1) ^ CRC8_POLYNOMIAL : (crc << 1);
+	return crc;
+}
+
+uint8_t crc8(const uint8_t* data, uint8_t length)
+{
+	uint8_t crc = 0;
+
+	while (length--)
+		crc = crc8Update(crc, *data++);
+	return crc;
+}
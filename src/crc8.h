@@ -0,0 +1,35 @@
+/*************************************************************************
+Title:    CKT-IIAB CRC-8
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     crc8.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _CRC8_H_
+#define _CRC8_H_
+
+#include <stdint.h>
+
+// CRC-8, polynomial x^8 + x^2 + x + 1 (0x07), initial value 0.  Bitwise
+//  rather than a 256 byte table - the frames it covers are only a few bytes.
+#define CRC8_POLYNOMIAL  0x07
+
+uint8_t crc8Update(uint8_t crc, uint8_t data);
+uint8_t crc8(const uint8_t* data, uint8_t length);
+
+#endif
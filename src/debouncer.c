@@ -27,3 +27,124 @@ uint8_t getDebouncedState(DebounceState8_t* d)
 	return d->debounced_state;
 }
 
+
+void initDebounceState16(DebounceState16_t* d, uint16_t initialState)
+{
+	d->clock_A = d->clock_B = 0;
+	d->debounced_state = initialState;
+}
+
+uint16_t debounce16(uint16_t raw_inputs, DebounceState16_t* d)
+{
+	uint16_t delta = raw_inputs ^ d->debounced_state;
+	uint16_t changes;
+
+	d->clock_A ^= d->clock_B;
+	d->clock_B  = ~d->clock_B;
+
+	d->clock_A &= delta;
+	d->clock_B &= delta;
+
+	changes = ~((~delta) | d->clock_A | d->clock_B);
+	d->debounced_state ^= changes;
+	return(changes & ~(d->debounced_state));
+}
+
+uint16_t getDebouncedState16(DebounceState16_t* d)
+{
+	return d->debounced_state;
+}
+
+void initDebounceState32(DebounceState32_t* d, uint32_t initialState)
+{
+	d->clock_A = d->clock_B = 0;
+	d->debounced_state = initialState;
+}
+
+uint32_t debounce32(uint32_t raw_inputs, DebounceState32_t* d)
+{
+	uint32_t delta = raw_inputs ^ d->debounced_state;
+	uint32_t changes;
+
+	d->clock_A ^= d->clock_B;
+	d->clock_B  = ~d->clock_B;
+
+	d->clock_A &= delta;
+	d->clock_B &= delta;
+
+	changes = ~((~delta) | d->clock_A | d->clock_B);
+	d->debounced_state ^= changes;
+	return(changes & ~(d->debounced_state));
+}
+
+uint32_t getDebouncedState32(DebounceState32_t* d)
+{
+	return d->debounced_state;
+}
+
+void initDebounceTimed8(DebounceTimed8_t* d, uint8_t initialState)
+{
+	uint8_t i;
+
+	for (i = 0; i < DEBOUNCE_TIMED_BITS; i++)
+		d->count[i] = d->assertTicks[i] = d->releaseTicks[i] = 0;
+	d->raw = d->debounced_state = initialState;
+}
+
+// Writes the times into the planes for just these channels
+void debounceTimed8SetTicks(DebounceTimed8_t* d, uint8_t channels, uint8_t assertTicks, uint8_t releaseTicks)
+{
+	uint8_t i;
+
+	for (i = 0; i < DEBOUNCE_TIMED_BITS; i++)
+	{
+		d->assertTicks[i] = (d->assertTicks[i] & ~channels) | ((assertTicks & 0x01) ? channels : 0);
+		d->releaseTicks[i] = (d->releaseTicks[i] & ~channels) | ((releaseTicks & 0x01) ? channels : 0);
+		assertTicks >>= 1;
+		releaseTicks >>= 1;
+	}
+}
+
+void debounceTimed8Input(DebounceTimed8_t* d, uint8_t raw_inputs)
+{
+	uint8_t moved = raw_inputs ^ d->raw;
+	uint8_t i;
+
+	for (i = 0; i < DEBOUNCE_TIMED_BITS; i++)
+		d->count[i] &= ~moved;
+	d->raw = raw_inputs;
+}
+
+// Returns the channels that changed state
+uint8_t debounceTimed8Tick(DebounceTimed8_t* d)
+{
+	uint8_t pending = d->raw ^ d->debounced_state;   // Channels waiting to change
+	uint8_t carry = pending;
+	uint8_t differ = 0;
+	uint8_t changes;
+	uint8_t i;
+
+	for (i = 0; i < DEBOUNCE_TIMED_BITS; i++)
+	{
+		// Ripple count up the pending channels, clear the rest
+		uint8_t count = d->count[i];
+		uint8_t next = (count ^ carry) & pending;
+		carry &= count;
+		d->count[i] = next;
+
+		// Against the release time where the state is 1, the assert time where it's 0
+		uint8_t limit = (d->releaseTicks[i] & d->debounced_state) | (d->assertTicks[i] & ~d->debounced_state);
+		differ |= next ^ limit;
+	}
+
+	changes = pending & ~differ;
+	d->debounced_state ^= changes;
+	for (i = 0; i < DEBOUNCE_TIMED_BITS; i++)
+		d->count[i] &= ~changes;
+	return changes;
+}
+
+uint8_t getDebouncedTimed8State(DebounceTimed8_t* d)
+{
+	return d->debounced_state;
+}
@@ -15,4 +15,54 @@ void initDebounceState8(DebounceState8_t* d, uint8_t initialState);
 uint8_t debounce8(uint8_t raw_inputs, DebounceState8_t* d);
 uint8_t getDebouncedState(DebounceState8_t* d);
 
+// The same four sample debounce, 16 and 32 channels wide.  A pass costs the
+//  same however many of the channels are in use.
+
+typedef struct
+{
+	uint16_t clock_A;
+	uint16_t clock_B;
+	uint16_t debounced_state;
+} DebounceState16_t;
+
+void initDebounceState16(DebounceState16_t* d, uint16_t initialState);
+uint16_t debounce16(uint16_t raw_inputs, DebounceState16_t* d);
+uint16_t getDebouncedState16(DebounceState16_t* d);
+
+typedef struct
+{
+	uint32_t clock_A;
+	uint32_t clock_B;
+	uint32_t debounced_state;
+} DebounceState32_t;
+
+void initDebounceState32(DebounceState32_t* d, uint32_t initialState);
+uint32_t debounce32(uint32_t raw_inputs, DebounceState32_t* d);
+uint32_t getDebouncedState32(DebounceState32_t* d);
+
+// Timed debouncer - every channel has its own assert (0 to 1) and release
+//  (1 to 0) time, in ticks of whatever rate debounceTimed8Tick() is called
+//  at.  Like debounce8() it's bit-sliced: each channel's tick counter is one
+//  bit in each of the count planes, so all eight step together.
+// Feed it the raw inputs whenever they change (an edge restarts the count
+//  for the channels that moved) and tick it.  A channel changes state after
+//  its raw input has been the other way for assert or release ticks.
+
+#define DEBOUNCE_TIMED_BITS  8   // Times of 1 - 255 ticks
+
+typedef struct
+{
+	uint8_t count[DEBOUNCE_TIMED_BITS];
+	uint8_t assertTicks[DEBOUNCE_TIMED_BITS];
+	uint8_t releaseTicks[DEBOUNCE_TIMED_BITS];
+	uint8_t raw;
+	uint8_t debounced_state;
+} DebounceTimed8_t;
+
+void initDebounceTimed8(DebounceTimed8_t* d, uint8_t initialState);
+void debounceTimed8SetTicks(DebounceTimed8_t* d, uint8_t channels, uint8_t assertTicks, uint8_t releaseTicks);
+void debounceTimed8Input(DebounceTimed8_t* d, uint8_t raw_inputs);
+uint8_t debounceTimed8Tick(DebounceTimed8_t* d);
+uint8_t getDebouncedTimed8State(DebounceTimed8_t* d);
+
 #endif
@@ -0,0 +1,50 @@
+/*************************************************************************
+Title:    Approach Delay Selection
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     delay.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <avr/pgmspace.h>
+#include "prng.h"
+#include "delay.h"
+#include "delayProfiles.h"
+
+uint32_t delaySelectSeconds(uint8_t delaySetting, bool randomized)
+{
+	if(!randomized)
+	{
+		// Fixed delays
+		return delaySetting * DELAY_FIXED_STEP_SECONDS;
+	}
+
+	const DelayProfile_t* profile = &delayProfiles[delaySetting % DELAY_PROFILE_SETTINGS];
+	const DelaySegment_t* segment = (const DelaySegment_t*)pgm_read_ptr(&profile->segments);
+	const uint8_t* guide = (const uint8_t*)pgm_read_ptr(&profile->guide);
+	uint32_t draw = prngNext();
+	uint16_t u = draw >> 16;
+
+	// Find the segment the draw landed in - the one its guide cell starts in,
+	//  or the next if the draw is past that one's end
+	segment += pgm_read_byte(&guide[(uint8_t)(u >> 8) >> pgm_read_byte(&profile->guideShift)]);
+	if(u > pgm_read_word(&segment->uLast))
+		segment++;
+
+	uint16_t v = pgm_read_word(&segment->vStart) + (((uint32_t)(uint16_t)draw * pgm_read_word(&segment->vSpan)) >> 16);
+	return v >> DELAY_PROFILE_FRACTION_BITS;
+}
@@ -0,0 +1,69 @@
+/*************************************************************************
+Title:    Approach Delay Selection
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     delay.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _DELAY_H_
+#define _DELAY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// What a skipped delay actually waits
+#define DELAY_NONE_SECONDS  1
+
+// Fixed delays (random off) are this many seconds per DIP step
+#define DELAY_FIXED_STEP_SECONDS  5
+
+// Random delay profiles
+// Each DIP setting has a piecewise inverse CDF in program memory, generated
+//  by host/delaygen from delayProfiles.txt into delayProfiles.h.  The top 16
+//  bits (u) of one PRNG draw pick a segment (each covers the u after the
+//  segment before it, up to uLast) and the bottom 16 bits place the delay
+//  evenly across that segment's [vStart, vStart + vSpan).
+// To find the segment without a search, the top bits of u index a guide of
+//  equal cells, each naming the segment the cell starts in.  delaygen sizes
+//  the guide so no cell holds more than one segment end, leaving at most one
+//  step forward to take.
+// Delays are in 1/128 second, so profiles can run out to 511 seconds.
+
+#define DELAY_PROFILE_FRACTION_BITS  7
+#define DELAY_PROFILE_SETTINGS       16
+
+typedef struct
+{
+	uint16_t uLast;    // Cumulative probability * 65536 at the end of this segment, less one
+	uint16_t vStart;   // Shortest delay in this segment
+	uint16_t vSpan;    // Delay range covered by this segment, 0 for an exact value
+} DelaySegment_t;
+
+typedef struct
+{
+	const DelaySegment_t* segments;
+	const uint8_t* guide;   // Segment each cell starts in, indexed by (u >> 8) >> guideShift
+	uint8_t guideShift;
+} DelayProfile_t;
+
+// Picks the delay for the next approach from the delay DIP setting (0-15).
+// Randomized settings draw from the PRNG (prng.h), so seed it first.
+// This is also built into host/delaymc.c, which checks the distributions.
+uint32_t delaySelectSeconds(uint8_t delaySetting, bool randomized);
+
+#endif
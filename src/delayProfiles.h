@@ -0,0 +1,219 @@
+// Generated by host/delaygen from delayProfiles.txt - do not edit, run "make profiles"
+
+#ifndef _DELAY_PROFILES_H_
+#define _DELAY_PROFILES_H_
+
+#include <avr/pgmspace.h>
+#include "delay.h"
+
+// { uLast, vStart, vSpan } and guide cells - see delay.h
+
+// 0  | 100 uniform 0 10
+static const DelaySegment_t delayProfile0[] PROGMEM =
+{
+	{ 65535,     0,  1408 },  // 100.000%  0.000 - 11.000s
+};
+
+static const uint8_t delayGuide0[] PROGMEM =
+{
+	  0,
+};
+
+// 1  | 100 uniform 5 20
+static const DelaySegment_t delayProfile1[] PROGMEM =
+{
+	{ 65535,   640,  2048 },  // 100.000%  5.000 - 21.000s
+};
+
+static const uint8_t delayGuide1[] PROGMEM =
+{
+	  0,
+};
+
+// 2  | 100 uniform 15 30
+static const DelaySegment_t delayProfile2[] PROGMEM =
+{
+	{ 65535,  1920,  2048 },  // 100.000%  15.000 - 31.000s
+};
+
+static const uint8_t delayGuide2[] PROGMEM =
+{
+	  0,
+};
+
+// 3  | 100 uniform 30 60
+static const DelaySegment_t delayProfile3[] PROGMEM =
+{
+	{ 65535,  3840,  3968 },  // 100.000%  30.000 - 61.000s
+};
+
+static const uint8_t delayGuide3[] PROGMEM =
+{
+	  0,
+};
+
+// 4  | 90 none | 10 uniform 15 30
+static const DelaySegment_t delayProfile4[] PROGMEM =
+{
+	{ 58981,   128,     0 },  //  89.999%  1.000 - 1.000s
+	{ 65535,  1920,  2048 },  //  10.001%  15.000 - 31.000s
+};
+
+static const uint8_t delayGuide4[] PROGMEM =
+{
+	  0,
+};
+
+// 5  | 70 none | 30 uniform 15 30
+static const DelaySegment_t delayProfile5[] PROGMEM =
+{
+	{ 45874,   128,     0 },  //  70.000%  1.000 - 1.000s
+	{ 65535,  1920,  2048 },  //  30.000%  15.000 - 31.000s
+};
+
+static const uint8_t delayGuide5[] PROGMEM =
+{
+	  0,
+};
+
+// 6  | 25 none | 75 uniform 15 30
+static const DelaySegment_t delayProfile6[] PROGMEM =
+{
+	{ 16383,   128,     0 },  //  25.000%  1.000 - 1.000s
+	{ 65535,  1920,  2048 },  //  75.000%  15.000 - 31.000s
+};
+
+static const uint8_t delayGuide6[] PROGMEM =
+{
+	  0,
+};
+
+// 7  | 90 none | 10 uniform 30 60
+static const DelaySegment_t delayProfile7[] PROGMEM =
+{
+	{ 58981,   128,     0 },  //  89.999%  1.000 - 1.000s
+	{ 65535,  3840,  3968 },  //  10.001%  30.000 - 61.000s
+};
+
+static const uint8_t delayGuide7[] PROGMEM =
+{
+	  0,
+};
+
+// 8  | 70 none | 30 uniform 30 60
+static const DelaySegment_t delayProfile8[] PROGMEM =
+{
+	{ 45874,   128,     0 },  //  70.000%  1.000 - 1.000s
+	{ 65535,  3840,  3968 },  //  30.000%  30.000 - 61.000s
+};
+
+static const uint8_t delayGuide8[] PROGMEM =
+{
+	  0,
+};
+
+// 9  | 25 none | 75 uniform 30 60
+static const DelaySegment_t delayProfile9[] PROGMEM =
+{
+	{ 16383,   128,     0 },  //  25.000%  1.000 - 1.000s
+	{ 65535,  3840,  3968 },  //  75.000%  30.000 - 61.000s
+};
+
+static const uint8_t delayGuide9[] PROGMEM =
+{
+	  0,
+};
+
+// 10 | 90 none | 10 uniform 60 120
+static const DelaySegment_t delayProfile10[] PROGMEM =
+{
+	{ 58981,   128,     0 },  //  89.999%  1.000 - 1.000s
+	{ 65535,  7680,  7808 },  //  10.001%  60.000 - 121.000s
+};
+
+static const uint8_t delayGuide10[] PROGMEM =
+{
+	  0,
+};
+
+// 11 | 70 none | 30 uniform 60 120
+static const DelaySegment_t delayProfile11[] PROGMEM =
+{
+	{ 45874,   128,     0 },  //  70.000%  1.000 - 1.000s
+	{ 65535,  7680,  7808 },  //  30.000%  60.000 - 121.000s
+};
+
+static const uint8_t delayGuide11[] PROGMEM =
+{
+	  0,
+};
+
+// 12 | 25 none | 75 uniform 60 120
+static const DelaySegment_t delayProfile12[] PROGMEM =
+{
+	{ 16383,   128,     0 },  //  25.000%  1.000 - 1.000s
+	{ 65535,  7680,  7808 },  //  75.000%  60.000 - 121.000s
+};
+
+static const uint8_t delayGuide12[] PROGMEM =
+{
+	  0,
+};
+
+// 13 | 90 none | 10 uniform 180 300
+static const DelaySegment_t delayProfile13[] PROGMEM =
+{
+	{ 58981,   128,     0 },  //  89.999%  1.000 - 1.000s
+	{ 65535, 23040, 15488 },  //  10.001%  180.000 - 301.000s
+};
+
+static const uint8_t delayGuide13[] PROGMEM =
+{
+	  0,
+};
+
+// 14 | 70 none | 30 uniform 180 300
+static const DelaySegment_t delayProfile14[] PROGMEM =
+{
+	{ 45874,   128,     0 },  //  70.000%  1.000 - 1.000s
+	{ 65535, 23040, 15488 },  //  30.000%  180.000 - 301.000s
+};
+
+static const uint8_t delayGuide14[] PROGMEM =
+{
+	  0,
+};
+
+// 15 | 25 none | 75 uniform 180 300
+static const DelaySegment_t delayProfile15[] PROGMEM =
+{
+	{ 16383,   128,     0 },  //  25.000%  1.000 - 1.000s
+	{ 65535, 23040, 15488 },  //  75.000%  180.000 - 301.000s
+};
+
+static const uint8_t delayGuide15[] PROGMEM =
+{
+	  0,
+};
+
+static const DelayProfile_t delayProfiles[DELAY_PROFILE_SETTINGS] PROGMEM =
+{
+	{ delayProfile0, delayGuide0, 8 },
+	{ delayProfile1, delayGuide1, 8 },
+	{ delayProfile2, delayGuide2, 8 },
+	{ delayProfile3, delayGuide3, 8 },
+	{ delayProfile4, delayGuide4, 8 },
+	{ delayProfile5, delayGuide5, 8 },
+	{ delayProfile6, delayGuide6, 8 },
+	{ delayProfile7, delayGuide7, 8 },
+	{ delayProfile8, delayGuide8, 8 },
+	{ delayProfile9, delayGuide9, 8 },
+	{ delayProfile10, delayGuide10, 8 },
+	{ delayProfile11, delayGuide11, 8 },
+	{ delayProfile12, delayGuide12, 8 },
+	{ delayProfile13, delayGuide13, 8 },
+	{ delayProfile14, delayGuide14, 8 },
+	{ delayProfile15, delayGuide15, 8 },
+};
+
+#endif
@@ -0,0 +1,49 @@
+/*************************************************************************
+Title:    CKT-IIAB EEPROM Map
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     eepromMap.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _EEPROM_MAP_H_
+#define _EEPROM_MAP_H_
+
+#include "hal.h"
+
+// Where everything lives in the ATtiny861A's 512 bytes of EEPROM
+//  0x000 - 0x13F   Event log, 10 blocks of 32 bytes (eventLog.h)
+//  0x140 - 0x197   Statistics snapshot
+//  0x198 - 0x1FF   Event trace dump after a reset (trace.h)
+
+#define EEPROM_LOG_ADDR         0x000
+#define EEPROM_LOG_BLOCK_SIZE   32
+#define EEPROM_LOG_BLOCKS       10
+
+#define EEPROM_STATS_ADDR       0x140
+#define EEPROM_STATS_SIZE       88
+
+#define EEPROM_TRACE_ADDR       0x198
+#define EEPROM_TRACE_SIZE       104
+
+#if (EEPROM_LOG_ADDR + EEPROM_LOG_BLOCKS * EEPROM_LOG_BLOCK_SIZE) > EEPROM_STATS_ADDR \
+	|| (EEPROM_STATS_ADDR + EEPROM_STATS_SIZE) > EEPROM_TRACE_ADDR \
+	|| (EEPROM_TRACE_ADDR + EEPROM_TRACE_SIZE) > HAL_EEPROM_SIZE
+#error "EEPROM areas overlap"
+#endif
+
+#endif
@@ -0,0 +1,179 @@
+/*************************************************************************
+Title:    CKT-IIAB EEPROM Event Log
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     eventLog.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "hal.h"
+#include "eventLog.h"
+
+static uint8_t logBlock;                          // Newest block
+static uint8_t logImage[EEPROM_LOG_BLOCK_SIZE];   // What it should hold
+static uint8_t logFill;                           // First free byte in logImage
+static uint8_t logWrite;                          // Next byte of logImage to write out
+static bool logSequencePending;                   // Byte 0 still to write, after the rest
+static bool logBoot;
+static uint32_t logLastMillis;
+
+static uint16_t logAddress(uint8_t block, uint8_t offset)
+{
+	return EEPROM_LOG_ADDR + block * EEPROM_LOG_BLOCK_SIZE + offset;
+}
+
+static uint8_t varintPut(uint8_t* data, uint32_t value)
+{
+	uint8_t n = 0;
+
+	while (value > 0x7F)
+	{
+		data[n++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	data[n++] = value;
+	return n;
+}
+
+// Bytes in the record at data, or 0 if it runs off the end (torn write)
+static uint8_t recordLength(const uint8_t* data, uint8_t length)
+{
+	uint8_t n = 1, varints = (data[0] & EVENT_LOG_UNCLEARED) ? 3 : 4;
+
+	while (n < length)
+	{
+		if (!(data[n++] & 0x80) && 0 == --varints)
+			return n;
+	}
+	return 0;
+}
+
+// Blocking reads, so call it before the main loop
+void eventLogInitialize(void)
+{
+	uint8_t block, offset;
+
+	logBlock = EEPROM_LOG_BLOCKS - 1;
+	for (block = 0; block < EEPROM_LOG_BLOCKS; block++)
+	{
+		uint8_t sequence = halEepromRead(logAddress(block, 0));
+		uint8_t next = halEepromRead(logAddress((block + 1) % EEPROM_LOG_BLOCKS, 0));
+		if (next != (uint8_t)(sequence + 1))
+		{
+			logBlock = block;
+			break;
+		}
+	}
+
+	for (offset = 0; offset < EEPROM_LOG_BLOCK_SIZE; offset++)
+		logImage[offset] = halEepromRead(logAddress(logBlock, offset));
+
+	logFill = 1;
+	while (logFill < EEPROM_LOG_BLOCK_SIZE && EVENT_LOG_END != logImage[logFill])
+	{
+		uint8_t length = recordLength(logImage + logFill, EEPROM_LOG_BLOCK_SIZE - logFill);
+		if (0 == length)
+		{
+			logFill = EEPROM_LOG_BLOCK_SIZE;  // Torn record, leave the rest of the block alone
+			break;
+		}
+		logFill += length;
+	}
+
+	logWrite = EEPROM_LOG_BLOCK_SIZE;
+	logSequencePending = false;
+	logBoot = true;
+	logLastMillis = 0;
+}
+
+bool eventLogIdle(void)
+{
+	return logWrite >= EEPROM_LOG_BLOCK_SIZE && !logSequencePending;
+}
+
+// Queues the record for eventLogUpdate() to write.  Returns false (and drops
+//  it) if the last one is still being written.
+bool eventLogRecord(const EventLogEntry_t* entry, uint32_t now)
+{
+	uint8_t record[EVENT_LOG_MAX_RECORD];
+	uint8_t length = 1;
+	bool cleared = entry->clearSeconds >= entry->delaySeconds;  // Can't clear before the delay is up
+
+	if (!eventLogIdle())
+		return false;
+
+	record[0] = ((entry->direction & 0x01) ? EVENT_LOG_DIRECTION_B : 0)
+		| ((entry->outcome << EVENT_LOG_OUTCOME_SHIFT) & EVENT_LOG_OUTCOME_MASK)
+		| (entry->randomized ? EVENT_LOG_RANDOM : 0)
+		| (entry->express ? EVENT_LOG_EXPRESS : 0)
+		| (logBoot ? EVENT_LOG_BOOT : 0)
+		| (cleared ? 0 : EVENT_LOG_UNCLEARED);
+	uint32_t seconds = (now - logLastMillis) / 1000;
+	length += varintPut(record + length, seconds);
+	length += varintPut(record + length, entry->delaySeconds);
+	if (cleared)
+		length += varintPut(record + length, entry->clearSeconds - entry->delaySeconds);
+	length += varintPut(record + length, entry->occupiedSeconds);
+	logLastMillis += seconds * 1000;  // Carry the part second over to the next one
+	logBoot = false;
+
+	if (logFill + length > EEPROM_LOG_BLOCK_SIZE)
+	{
+		// On to the next block - this record and blanks, then the sequence number
+		uint8_t sequence = logImage[0] + 1;
+
+		logBlock = (logBlock + 1) % EEPROM_LOG_BLOCKS;
+		memset(logImage, EVENT_LOG_END, sizeof(logImage));
+		logImage[0] = sequence;
+		logFill = 1;
+		logSequencePending = true;
+	}
+
+	memcpy(logImage + logFill, record, length);
+	logWrite = logSequencePending ? 1 : logFill;
+	logFill += length;
+	return true;
+}
+
+// Call from the main loop.  Starts at most one EEPROM write, skipping bytes
+//  that already hold the right value.
+void eventLogUpdate(void)
+{
+	if (halEepromBusy())
+		return;
+
+	while (logWrite < EEPROM_LOG_BLOCK_SIZE)
+	{
+		uint8_t offset = logWrite++;
+		uint16_t address = logAddress(logBlock, offset);
+
+		if (halEepromRead(address) != logImage[offset])
+		{
+			halEepromWriteStart(address, logImage[offset]);
+			return;
+		}
+	}
+
+	if (logSequencePending)
+	{
+		logSequencePending = false;
+		halEepromWriteStart(logAddress(logBlock, 0), logImage[0]);
+	}
+}
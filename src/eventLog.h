@@ -0,0 +1,88 @@
+/*************************************************************************
+Title:    CKT-IIAB EEPROM Event Log
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     eventLog.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _EVENT_LOG_H_
+#define _EVENT_LOG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "eepromMap.h"
+
+// One record per interlocking cycle, kept in EEPROM across power cycles.
+//
+// The log area is a ring of EEPROM_LOG_BLOCKS blocks, filled one after the
+//  other so every block wears the same.  Byte 0 of a block is its sequence
+//  number, one more than the block before it; the newest block is the one
+//  the next block doesn't follow.  The rest holds whole records, then 0xFF.
+//  A new block is written payload first and sequence number last, so losing
+//  power part way leaves it looking like the oldest block rather than the
+//  newest.
+//
+// A record is a header byte (EVENT_LOG_* bits, never 0xFF) followed by
+//  unsigned LEB128 varints:
+//  seconds since the record before it (since power up, with EVENT_LOG_BOOT)
+//  delay seconds
+//  seconds the signal took to clear after the delay ran out, left out with
+//   EVENT_LOG_UNCLEARED
+//  seconds the diamond was occupied
+// A cycle every minute or two with delays under 128 seconds takes five or
+//  six bytes, so the log holds the last 50-60 cycles.  Longer delays and
+//  longer gaps between trains need a second byte each, down to about 40.
+//
+// Writes go one byte per main loop pass as the EEPROM becomes ready
+//  (halEepromBusy()), so nothing waits ~3.4ms for a byte to program.
+
+#define EVENT_LOG_DIRECTION_B   0x01
+#define EVENT_LOG_OUTCOME_MASK  0x06
+#define EVENT_LOG_OUTCOME_SHIFT 1
+#define EVENT_LOG_RANDOM        0x08
+#define EVENT_LOG_EXPRESS       0x10
+#define EVENT_LOG_BOOT          0x20   // First record since power up
+#define EVENT_LOG_UNCLEARED     0x40   // Signal never cleared, no clear time
+#define EVENT_LOG_END           0xFF   // Unused space in a block
+
+#define EVENT_LOG_MAX_RECORD    (1 + 5 + 3 * 3)   // A 32 bit varint and three 16 bit ones
+
+typedef enum
+{
+	EVENT_OUTCOME_CLEARED = 0,   // Train ran through to the far approach
+	EVENT_OUTCOME_LOCKOUT = 1,   // Diamond cleared without reaching it, locked out
+	EVENT_OUTCOME_TIMEOUT = 2,   // Approach cleared without the train entering
+} EventOutcome;
+
+typedef struct
+{
+	uint8_t direction;       // APPROACH_A or APPROACH_B
+	uint8_t outcome;         // EventOutcome
+	bool randomized;
+	bool express;
+	uint16_t delaySeconds;
+	uint16_t clearSeconds;
+	uint16_t occupiedSeconds;
+} EventLogEntry_t;
+
+void eventLogInitialize(void);
+bool eventLogRecord(const EventLogEntry_t* entry, uint32_t now);
+void eventLogUpdate(void);
+bool eventLogIdle(void);
+
+#endif
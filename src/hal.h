@@ -0,0 +1,259 @@
+/*************************************************************************
+Title:    CKT-IIAB Hardware Abstraction Layer
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     hal.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _HAL_H_
+#define _HAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "light_ws2812.h"
+
+// Everything that touches an ATtiny861A register lives behind this interface.
+// hal_avr.c implements it for the real board, host/hal_host.c implements it
+// for the Linux build ("make host") on top of a virtual clock.
+
+// Timer0 timebase
+// Software PWM: CTC at 8MHz / 8, compare every 251 counts (~4kHz), or at
+//  8MHz / 64 every 125 counts (1kHz) while the PWM is idle
+// Bit Angle Modulation: free running at 8MHz / 64, compare A for the PWM bits
+//  and compare B every 125 counts (1ms) for millis
+#ifdef SIGNAL_PWM_BAM
+#define HAL_TIMER0_PRESCALER  64
+#define HAL_TICK_COUNTS       125
+#else
+#define HAL_TIMER0_PRESCALER  8
+#define HAL_TICK_COUNTS       250
+#define HAL_IDLE_TICK_COUNTS  124   // 1:64 prescaler while the PWM is idle, 1kHz
+#endif
+
+// Timer1 hardware PWM channels (SIGNAL_PWM_TIMER1)
+#define HAL_HW_PWM_OC1A     0   // PB1
+#define HAL_HW_PWM_OC1B     1   // PB3
+
+// Lamps through a chain of SIGNAL_OUTPUT_SHIFT_REGISTERS (1 - 4) 74HC595s
+//  in place of PB0 - PB3, which drive the chain instead: the USI in three
+//  wire mode on PB1 (DO) to SER and PB2 (USCK) to SRCLK, and PB3 to RCLK.
+//  PB0 (DI) isn't used.  /OE is tied low and /SRCLR high.
+// Byte n of a frame goes to chip n, the first being the one wired to PB1,
+//  with bit 0 on QA.
+#ifdef SIGNAL_OUTPUT_SHIFT_REGISTERS
+#if SIGNAL_OUTPUT_SHIFT_REGISTERS < 1 || SIGNAL_OUTPUT_SHIFT_REGISTERS > 4
+#error "SIGNAL_OUTPUT_SHIFT_REGISTERS has to be 1 - 4"
+#endif
+#ifdef SIGNAL_PWM_TIMER1
+#error "SIGNAL_OUTPUT_SHIFT_REGISTERS needs PB1 and PB3, so can't be built with SIGNAL_PWM_TIMER1"
+#endif
+#endif
+
+#ifdef HOST_BUILD
+
+// Stand-in for PORTB so the signal head engine can keep writing through a port pointer
+extern volatile uint8_t halHostSignalPort;
+#define HAL_SIGNAL_PORT     halHostSignalPort
+
+void halTimerPWMAdvance(uint8_t counts);
+void halTimerTickAdvance(void);
+void halHardwarePWMSet(uint8_t channel, uint8_t duty, bool activeLow);
+uint8_t halTimerCount(void);
+void halSignalOutput(const uint8_t* frame);
+
+#else
+
+#include <avr/io.h>
+#define HAL_SIGNAL_PORT     PORTB
+
+// Called from the Timer0 interrupts, so these need to be inlined
+
+// Schedule the next compare A match this many counts after the last one (0 = 256)
+static inline void halTimerPWMAdvance(uint8_t counts)
+{
+	OCR0A += counts;
+}
+
+// Schedule the next 1ms compare B match
+static inline void halTimerTickAdvance(void)
+{
+	OCR0B += HAL_TICK_COUNTS;
+}
+
+// Put a signal port table phase (signalHead.h) on the lamps.  Through the
+//  shift registers that's 16 cycles a chip with the USI clocked by software
+//  strobes, plus the latch - about 10us for four chips.
+static inline void halSignalOutput(const uint8_t* frame)
+{
+#ifdef SIGNAL_OUTPUT_SHIFT_REGISTERS
+	const uint8_t clockHigh = _BV(USIWM0) | _BV(USITC);
+	const uint8_t clockLow = _BV(USIWM0) | _BV(USITC) | _BV(USICLK);
+	uint8_t chip = SIGNAL_OUTPUT_SHIFT_REGISTERS;
+
+	do
+	{
+		USIDR = frame[--chip];  // The last chip's byte goes in first, MSB (QH) first
+		USICR = clockHigh;
+		USICR = clockLow;
+		USICR = clockHigh;
+		USICR = clockLow;
+		USICR = clockHigh;
+		USICR = clockLow;
+		USICR = clockHigh;
+		USICR = clockLow;
+		USICR = clockHigh;
+		USICR = clockLow;
+		USICR = clockHigh;
+		USICR = clockLow;
+		USICR = clockHigh;
+		USICR = clockLow;
+		USICR = clockHigh;
+		USICR = clockLow;
+	} while (chip);
+
+	// Latch the lot onto the outputs.  Only ever called from the Timer0
+	//  interrupts, so the pair of toggles can't be split.
+	PINB = _BV(PB3);
+	PINB = _BV(PB3);
+#else
+	HAL_SIGNAL_PORT = frame[0];
+#endif
+}
+
+// Timer0 count, for timing the interrupts (telemetry.h)
+static inline uint8_t halTimerCount(void)
+{
+	return TCNT0L;
+}
+
+// Set a Timer1 PWM output.  A duty of 0 disconnects the output entirely (fast
+//  PWM would still leave a one count spike), leaving the pin to the port.
+static inline void halHardwarePWMSet(uint8_t channel, uint8_t duty, bool activeLow)
+{
+	uint8_t com = 0;
+	if (duty)
+		com = activeLow ? 0x03 : 0x02;  // Set on match / clear at bottom, or the reverse
+
+	if (HAL_HW_PWM_OC1A == channel)
+	{
+		OCR1A = duty;
+		TCCR1A = (TCCR1A & ~(_BV(COM1A1) | _BV(COM1A0))) | (com << COM1A0);
+	}
+	else
+	{
+		OCR1B = duty;
+		TCCR1A = (TCCR1A & ~(_BV(COM1B1) | _BV(COM1B0))) | (com << COM1B0);
+	}
+}
+
+#endif
+
+// ADC channels used by the option resistor ladders
+#define HAL_ADC_OPTIONS     3   // ADC3 (PA4) - random / searchlight
+#define HAL_ADC_TIMEOUT     4   // ADC4 (PA5) - timeout
+
+// Why the chip last reset (MCUSR bits, saved by halInitialize() before it
+//  clears them).  More than one can be set.
+#define HAL_RESET_POWER_ON  0x01
+#define HAL_RESET_EXTERNAL  0x02
+#define HAL_RESET_BROWN_OUT 0x04
+#define HAL_RESET_WATCHDOG  0x08
+
+void halInitialize(void);
+uint8_t halResetCause(void);
+void halInitializeTimer(void);
+void halTimerPWMIdle(bool idle);
+void halInitializeHardwarePWM(void);
+void halInitializeADC(void);
+
+uint8_t halReadADC(uint8_t channel);
+void halStartADC(uint8_t channel);
+uint8_t halReadADCResult(void);
+uint32_t halEntropy(void);
+uint8_t halReadOptionPins(void);
+bool halReadCommonAnode(void);  // The jumper on PA6, or HAL_COMMON_ANODE if the UART has it
+uint8_t halReadDetectorPins(void);
+
+// Pin change interrupt (PCINT_vect) on the detector pins, PB4 - PB6
+void halEnableDetectorInterrupt(void);
+
+#ifdef INPUT_SHIFT_REGISTERS
+// Detectors through a chain of INPUT_SHIFT_REGISTERS (1 - 4) 74HC165s in
+//  place of the three on PB4 - PB6, which drive the chain instead:
+//  PB4 - /PL (parallel load), PB5 - CP (clock), PB6 - Q7 of the first chip.
+// Input Dn of chip c (the first being the one wired to PB6) comes back as
+//  bit 8c + n.  The pins are returned as they are, high for a clear input.
+#if INPUT_SHIFT_REGISTERS < 1 || INPUT_SHIFT_REGISTERS > 4
+#error "INPUT_SHIFT_REGISTERS has to be 1 - 4"
+#endif
+uint32_t halReadShiftInputs(void);
+#endif
+
+// Microseconds since the last Timer0 interrupt that counts time (compare B
+//  with SIGNAL_PWM_BAM, compare A otherwise) ran, including one that has
+//  matched but not run yet.  Call with interrupts off.
+uint16_t halMicrosSinceTick(void);
+
+// EEPROM.  halEepromRead() and halEepromWrite() wait for any write still
+//  programming (~3.4ms).  halEepromWriteStart() doesn't - check
+//  halEepromBusy() first.
+#define HAL_EEPROM_SIZE     512
+
+uint8_t halEepromRead(uint16_t address);
+void halEepromWrite(uint16_t address, uint8_t data);
+bool halEepromBusy(void);
+void halEepromWriteStart(uint16_t address, uint8_t data);
+
+// Shifts out the status LED frame only - the caller has to leave
+//  ws2812_resettime before the next one
+void halStatusLedSend(struct cRGB* led);
+
+// Software UART on the AVR - 2400 baud, clocked by Timer1 so it can't be
+//  built with SIGNAL_PWM_TIMER1.  There's only the one, for either the link
+//  or the telemetry.  The stock board has no free pins, so each needs its
+//  pins given at build time, and only PA6 and PA7 can be had.  Taking PA6
+//  loses the common anode jumper - build with HAL_COMMON_ANODE (1 or 0) in
+//  its place.  Taking PA7 leaves the status LED dark.
+#define HAL_UART_BAUD       2400
+
+#ifdef LINK_ENABLE
+// Board-to-board link (link.h), a byte pipe to the neighbour on each link
+//  port.  Build with HAL_LINK_TX_BIT / HAL_LINK_RX_BIT, HAL_LINK_SIDE
+//  (LINK_PORT_A or LINK_PORT_B) for the neighbour it's wired to, and
+//  LINK_NODE for this board's number.
+#define HAL_LINK_BUFFER     16   // Power of two
+
+void halLinkInitialize(void);
+uint8_t halLinkNode(void);
+bool halLinkConnected(uint8_t port);
+uint8_t halLinkTxFree(uint8_t port);
+void halLinkSend(uint8_t port, uint8_t data);
+bool halLinkReceive(uint8_t port, uint8_t* data);
+#endif
+
+#ifdef TELEMETRY_ENABLE
+// Telemetry (telemetry.h), transmit only.  Build with HAL_TELEMETRY_TX_BIT,
+//  best PA7 - the status LED is all it costs, where PA6 loses the jumper.
+#define HAL_TELEMETRY_BUFFER  32   // Power of two, a whole frame
+
+void halTelemetryInitialize(void);
+uint8_t halTelemetryTxFree(void);
+void halTelemetrySend(uint8_t data);
+#endif
+
+#endif
@@ -0,0 +1,502 @@
+/*************************************************************************
+Title:    CKT-IIAB Hardware Abstraction Layer (ATtiny861A)
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     hal_avr.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <avr/io.h>
+#include <avr/wdt.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <util/atomic.h>
+#include "hal.h"
+#ifdef LINK_ENABLE
+#include "link.h"
+#endif
+
+#if defined(LINK_ENABLE) && defined(TELEMETRY_ENABLE)
+#error "LINK_ENABLE and TELEMETRY_ENABLE would both need the one software UART"
+#endif
+
+#ifdef LINK_ENABLE
+#if !defined(HAL_LINK_TX_BIT) || !defined(HAL_LINK_RX_BIT) || !defined(HAL_LINK_SIDE) || !defined(LINK_NODE)
+#error "LINK_ENABLE needs HAL_LINK_TX_BIT, HAL_LINK_RX_BIT, HAL_LINK_SIDE and LINK_NODE - see hal.h"
+#endif
+#define HAL_UART_TX_BIT      HAL_LINK_TX_BIT
+#define HAL_UART_RX_BIT      HAL_LINK_RX_BIT
+#define HAL_UART_BUFFER      HAL_LINK_BUFFER
+#endif
+
+#ifdef TELEMETRY_ENABLE
+#ifndef HAL_TELEMETRY_TX_BIT
+#error "TELEMETRY_ENABLE needs HAL_TELEMETRY_TX_BIT - see hal.h"
+#endif
+#define HAL_UART_TX_BIT      HAL_TELEMETRY_TX_BIT
+#define HAL_UART_BUFFER      HAL_TELEMETRY_BUFFER
+#endif
+
+// The stock board has nothing free on port A: PA0 - PA3 are the delay DIP
+//  switches, PA4 and PA5 the option ladders, PA6 the common anode jumper and
+//  PA7 the status LED.  The UART can only have the last two, and takes over
+//  whatever was on them.
+#ifdef HAL_UART_TX_BIT
+#if HAL_UART_TX_BIT < PA6 || HAL_UART_TX_BIT > PA7 || (defined(HAL_UART_RX_BIT) && (HAL_UART_RX_BIT < PA6 || HAL_UART_RX_BIT > PA7 || HAL_UART_RX_BIT == HAL_UART_TX_BIT))
+#error "The software UART can only have PA6 and PA7 - the rest of port A is the DIP switches and option ladders"
+#endif
+
+#if HAL_UART_TX_BIT == PA6 || (defined(HAL_UART_RX_BIT) && HAL_UART_RX_BIT == PA6)
+// The jumper would read back every bit sent or received, so the lamp wiring
+//  comes from the build instead
+#ifndef HAL_COMMON_ANODE
+#error "The software UART has the common anode jumper (PA6) - build with HAL_COMMON_ANODE=1 or 0 for the lamp wiring"
+#endif
+#define HAL_UART_HAS_JUMPER
+#endif
+
+#if HAL_UART_TX_BIT == PA7 || (defined(HAL_UART_RX_BIT) && HAL_UART_RX_BIT == PA7)
+// The status LED stays dark rather than toggling the UART's pin
+#define HAL_UART_HAS_STATUS_LED
+#endif
+#endif
+
+static uint8_t resetCause;
+
+void halInitialize(void)
+{
+	// Keep the reset flags, then kill watchdog
+	resetCause = MCUSR & (_BV(PORF) | _BV(EXTRF) | _BV(BORF) | _BV(WDRF));
+	MCUSR = 0;
+	wdt_reset();
+	WDTCR = _BV(WDE) | _BV(WDP2) | _BV(WDP1);   // Enable WDT (1s)
+	wdt_reset();
+
+	PORTA = 0x0F;  // Pull-ups on PA0 - PA3
+#ifdef HAL_UART_HAS_STATUS_LED
+	DDRA = 0;
+#else
+	DDRA = _BV(PA7);  // Aux LED output
+#endif
+#ifdef INPUT_SHIFT_REGISTERS
+	PORTB = _BV(PB4) | _BV(PB6);  // /PL idle high, clock low, pull-up on Q7
+	DDRB = _BV(PB0) | _BV(PB1) | _BV(PB2) | _BV(PB3) | _BV(PB4) | _BV(PB5);
+#else
+	PORTB = 0x70;  // Pull-ups on PB4 - PB6
+	DDRB = _BV(PB0) | _BV(PB1) | _BV(PB2) | _BV(PB3);
+#endif
+}
+
+uint8_t halResetCause(void)
+{
+	return resetCause;
+}
+
+void halInitializeTimer(void)
+{
+	TIMSK = 0;                                    // Timer interrupts OFF
+#ifdef SIGNAL_PWM_BAM
+	// Set up Timer/Counter0 free running, compare A for PWM bits, compare B for millis
+	TCCR0A = 0b00000000;  // Normal 8-bit mode
+	TCCR0B = 0b00000011;  // CS01 | CS00 - 1:64 prescaler
+	TCNT0L = 0;
+	OCR0A = 1;
+	OCR0B = HAL_TICK_COUNTS;
+	TIFR = _BV(OCF0A) | _BV(OCF0B);
+	TIMSK = _BV(OCIE0A) | _BV(OCIE0B);
+#else
+	// Set up Timer/Counter0 for 100Hz clock
+	TCCR0A = 0b00000001;  // CTC Mode
+	TCCR0B = 0b00000010;  // CS01 - 1:8 prescaler
+	OCR0A = HAL_TICK_COUNTS;           // 8MHz / 8 / 125 = 8kHz
+	TIMSK = _BV(OCIE0A);
+#endif
+}
+
+// Drop the PWM interrupt while the lamps are latched, or bring it back
+void halTimerPWMIdle(bool idle)
+{
+#ifdef SIGNAL_PWM_BAM
+	// Compare B keeps millis going on its own, just stop compare A
+	if (idle)
+		TIMSK &= ~_BV(OCIE0A);
+	else
+	{
+		OCR0A = TCNT0L + 2;
+		TIFR = _BV(OCF0A);
+		TIMSK |= _BV(OCIE0A);
+	}
+#else
+	// Slow the CTC tick from ~4kHz to 1kHz
+	TCNT0L = 0;
+	if (idle)
+	{
+		OCR0A = HAL_IDLE_TICK_COUNTS;
+		TCCR0B = 0b00000011;  // CS01 | CS00 - 1:64 prescaler, 8MHz / 64 / 125 = 1kHz
+	}
+	else
+	{
+		OCR0A = HAL_TICK_COUNTS;
+		TCCR0B = 0b00000010;  // CS01 - 1:8 prescaler
+	}
+#endif
+}
+
+void halInitializeHardwarePWM(void)
+{
+	// Timer1 fast PWM on OC1A and OC1B, 8-bit (TOP = OCR1C = 255)
+	// 8MHz / 32 / 256 = 977 Hz.  Outputs stay disconnected until a duty is set.
+	TCCR1A = _BV(PWM1A) | _BV(PWM1B);
+	TCCR1C = 0;
+	TCCR1D = 0;           // Fast PWM
+	OCR1C = 0xFF;
+	OCR1A = 0;
+	OCR1B = 0;
+	TCCR1B = _BV(CS12) | _BV(CS11);  // CK/32
+}
+
+void halInitializeADC(void)
+{
+	ADMUX  = 0b00100011;  // VCC reference voltage; left-adjust; ADC3 (PA4)
+	ADCSRA = 0b10000111;  // ADC enabled; Manual trigger; 1/128 prescaler
+	ADCSRB = 0b00000000;  // Unipolar; 1x gain; Free running mode
+	DIDR0 |= _BV(ADC3D) | _BV(ADC4D);  // Disable ADC3 (PA4) and ADC4 (PA5) digital input buffer
+}
+
+uint8_t halReadADC(uint8_t channel)
+{
+	ADMUX = (ADMUX & ~(_BV(MUX2) | _BV(MUX1) | _BV(MUX0))) | (channel & 0x07);
+	ADCSRA |= _BV(ADSC);  // Start the conversion
+	while(ADCSRA & _BV(ADSC));  // Wait for conversion to complete; no WD reset in case it takes too long
+	return ADCH;
+}
+
+// Start a conversion that finishes in the ADC_vect interrupt.  The flag is
+//  written back as a one to throw away any completion left by halReadADC().
+void halStartADC(uint8_t channel)
+{
+	ADMUX = (ADMUX & ~(_BV(MUX2) | _BV(MUX1) | _BV(MUX0))) | (channel & 0x07);
+	ADCSRA |= _BV(ADIF) | _BV(ADIE) | _BV(ADSC);
+}
+
+uint8_t halReadADCResult(void)
+{
+	return ADCH;
+}
+
+// Seed material from the noise in the bottom bits of the option ladders.
+// Uses blocking conversions, so call it before the background sampler starts.
+uint32_t halEntropy(void)
+{
+	uint32_t entropy = 0;
+	uint8_t i;
+
+	ADMUX &= ~_BV(ADLAR);  // Right adjust so ADCL has the noisy bits
+	for (i = 0; i < 32; i++)
+	{
+		ADMUX = (ADMUX & ~(_BV(MUX2) | _BV(MUX1) | _BV(MUX0))) | ((i & 0x01) ? HAL_ADC_TIMEOUT : HAL_ADC_OPTIONS);
+		ADCSRA |= _BV(ADSC);
+		while(ADCSRA & _BV(ADSC));
+		uint8_t lsbs = ADCL;  // ADCL first, then ADCH to release the result
+		(void)ADCH;
+		entropy = ((entropy << 3) | (entropy >> 29)) ^ lsbs;
+	}
+	ADMUX |= _BV(ADLAR);
+	return entropy;
+}
+
+uint8_t halReadOptionPins(void)
+{
+	return PINA;
+}
+
+bool halReadCommonAnode(void)
+{
+#ifdef HAL_UART_HAS_JUMPER
+	return HAL_COMMON_ANODE;
+#else
+	return 0 != (PINA & _BV(PA6));
+#endif
+}
+
+uint8_t halReadDetectorPins(void)
+{
+	return PINB;
+}
+
+#ifdef INPUT_SHIFT_REGISTERS
+
+// About 2us a bit.  The lamps share PORTB and the PWM interrupt stores the
+//  whole port, taking the other pins from a snapshot at the start of each
+//  frame.  Each pulse is set and cleared with interrupts off, so the
+//  interrupt only ever sees (and puts back) /PL high and the clock low.
+uint32_t halReadShiftInputs(void)
+{
+	uint32_t data = 0;
+	uint8_t chip, bit;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		PORTB &= ~_BV(PB4);  // Load the inputs
+		PORTB |= _BV(PB4);
+	}
+
+	for (chip = 0; chip < INPUT_SHIFT_REGISTERS; chip++)
+	{
+		uint8_t byte = 0;
+		for (bit = 0; bit < 8; bit++)
+		{
+			byte = (byte << 1) | ((PINB >> PB6) & 0x01);  // D7 first
+			ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+			{
+				PORTB |= _BV(PB5);
+				PORTB &= ~_BV(PB5);
+			}
+		}
+		data |= (uint32_t)byte << (8 * chip);
+	}
+	return data;
+}
+
+#endif
+
+void halEnableDetectorInterrupt(void)
+{
+	// PCINT12 - PCINT14 share PCIE0 with port A, which is left masked off
+	PCMSK0 = 0;
+	PCMSK1 = _BV(PCINT12) | _BV(PCINT13) | _BV(PCINT14);
+	GIFR = _BV(PCIF);
+	GIMSK |= _BV(PCIE0);
+}
+
+uint16_t halMicrosSinceTick(void)
+{
+#ifdef SIGNAL_PWM_BAM
+	// Free running, and compare B has already moved on to the next tick
+	uint8_t counts = TCNT0L - (uint8_t)(OCR0B - HAL_TICK_COUNTS);
+	return counts * 8;  // 1:64 prescaler
+#else
+	// CTC, so the count starts over at each tick.  A match that's still
+	//  pending has just restarted it.
+	uint16_t counts = TCNT0L;
+	if ((TIFR & _BV(OCF0A)) && counts < OCR0A / 2)
+		counts += OCR0A + 1;
+	return (TCCR0B & _BV(CS00)) ? counts * 8 : counts;  // 1:64 while idle, else 1:8
+#endif
+}
+
+uint8_t halEepromRead(uint16_t address)
+{
+	return eeprom_read_byte((const uint8_t*)address);
+}
+
+void halEepromWrite(uint16_t address, uint8_t data)
+{
+	eeprom_update_byte((uint8_t*)address, data);
+}
+
+bool halEepromBusy(void)
+{
+	return (EECR & _BV(EEPE)) != 0;
+}
+
+void halEepromWriteStart(uint16_t address, uint8_t data)
+{
+	EEAR = address;
+	EEDR = data;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		// EEPE has to follow EEMPE within four cycles.  Erase and write in one go.
+		EECR = _BV(EEMPE);
+		EECR |= _BV(EEPE);
+	}
+}
+
+void halStatusLedSend(struct cRGB* led)
+{
+#ifndef HAL_UART_HAS_STATUS_LED
+	ws2812_sendarray_mask((uint8_t*)led, 3, _BV(ws2812_pin));
+#endif
+}
+
+#ifdef HAL_UART_TX_BIT
+
+#ifdef SIGNAL_PWM_TIMER1
+#error "The software UART is clocked from Timer1, which SIGNAL_PWM_TIMER1 already has"
+#endif
+
+// Software UART, 8N1 (sent with two stop bits).  Timer1 ticks at four times
+//  the baud rate; the transmitter changes the line every fourth tick and the
+//  receiver samples each bit near its middle, timed from the start bit edge.
+#define HAL_UART_OVERSAMPLE  4
+#define HAL_UART_MASK        (HAL_UART_BUFFER - 1)
+
+static volatile uint8_t uartTxBuffer[HAL_UART_BUFFER];
+static volatile uint8_t uartTxHead, uartTxTail;
+static uint16_t uartTxShift;
+static uint8_t uartTxBits, uartTxTick;
+
+#ifdef HAL_UART_RX_BIT
+static volatile uint8_t uartRxBuffer[HAL_UART_BUFFER];
+static volatile uint8_t uartRxHead, uartRxTail;
+static uint8_t uartRxShift, uartRxBits, uartRxTick;
+#endif
+
+static void uartInitialize(void)
+{
+	PORTA |= _BV(HAL_UART_TX_BIT);  // Idle high
+	DDRA |= _BV(HAL_UART_TX_BIT);
+#ifdef HAL_UART_RX_BIT
+	PORTA |= _BV(HAL_UART_RX_BIT);  // Pull-up
+	DDRA &= ~_BV(HAL_UART_RX_BIT);
+#endif
+
+	// 8MHz / 32 / 26 = 9615 Hz, 2404 baud
+	TCCR1A = 0;
+	TCCR1C = 0;
+	TCCR1D = 0;
+	OCR1C = (F_CPU / 32 / (HAL_UART_BAUD * HAL_UART_OVERSAMPLE)) - 1;
+	TCCR1B = _BV(CS12) | _BV(CS11);  // CK/32
+	TIFR = _BV(TOV1);
+	TIMSK |= _BV(TOIE1);
+}
+
+static uint8_t uartTxFree(void)
+{
+	return HAL_UART_MASK - ((uartTxHead - uartTxTail) & HAL_UART_MASK);
+}
+
+static void uartSend(uint8_t data)
+{
+	uartTxBuffer[uartTxHead] = data;
+	uartTxHead = (uartTxHead + 1) & HAL_UART_MASK;
+}
+
+ISR(TIMER1_OVF_vect)
+{
+	if (uartTxBits)
+	{
+		if (0 == uartTxTick--)
+		{
+			uartTxTick = HAL_UART_OVERSAMPLE - 1;
+			if (uartTxShift & 0x01)
+				PORTA |= _BV(HAL_UART_TX_BIT);
+			else
+				PORTA &= ~_BV(HAL_UART_TX_BIT);
+			uartTxShift >>= 1;
+			uartTxBits--;
+		}
+	}
+	else if (uartTxHead != uartTxTail)
+	{
+		// Start bit, data LSB first, two stop bits
+		uartTxShift = 0x600 | ((uint16_t)uartTxBuffer[uartTxTail] << 1);
+		uartTxTail = (uartTxTail + 1) & HAL_UART_MASK;
+		uartTxBits = 11;
+		uartTxTick = 0;
+	}
+
+#ifdef HAL_UART_RX_BIT
+	uint8_t rx = PINA & _BV(HAL_UART_RX_BIT);
+
+	if (0 == uartRxBits)
+	{
+		if (!rx)
+		{
+			// Start bit seen up to a tick after its edge, so the middle of
+			//  the first data bit is about five ticks off
+			uartRxBits = 9;
+			uartRxTick = HAL_UART_OVERSAMPLE + 1;
+		}
+	}
+	else if (0 == --uartRxTick)
+	{
+		uartRxTick = HAL_UART_OVERSAMPLE;
+		if (--uartRxBits)
+		{
+			uartRxShift >>= 1;
+			if (rx)
+				uartRxShift |= 0x80;
+		}
+		else if (rx && ((uartRxHead + 1) & HAL_UART_MASK) != uartRxTail)
+		{
+			// Good stop bit and somewhere to put it
+			uartRxBuffer[uartRxHead] = uartRxShift;
+			uartRxHead = (uartRxHead + 1) & HAL_UART_MASK;
+		}
+	}
+#endif
+}
+
+#endif
+
+#ifdef LINK_ENABLE
+
+void halLinkInitialize(void)
+{
+	uartInitialize();
+}
+
+uint8_t halLinkNode(void)
+{
+	return LINK_NODE;
+}
+
+bool halLinkConnected(uint8_t port)
+{
+	return HAL_LINK_SIDE == port;
+}
+
+uint8_t halLinkTxFree(uint8_t port)
+{
+	return uartTxFree();
+}
+
+void halLinkSend(uint8_t port, uint8_t data)
+{
+	uartSend(data);
+}
+
+bool halLinkReceive(uint8_t port, uint8_t* data)
+{
+	if (uartRxHead == uartRxTail)
+		return false;
+	*data = uartRxBuffer[uartRxTail];
+	uartRxTail = (uartRxTail + 1) & HAL_UART_MASK;
+	return true;
+}
+
+#endif
+
+#ifdef TELEMETRY_ENABLE
+
+void halTelemetryInitialize(void)
+{
+	uartInitialize();
+}
+
+uint8_t halTelemetryTxFree(void)
+{
+	return uartTxFree();
+}
+
+void halTelemetrySend(uint8_t data)
+{
+	uartSend(data);
+}
+
+#endif
@@ -0,0 +1,22 @@
+/*************************************************************************
+Title:    Host stand-in for <avr/interrupt.h>
+File:     host/avr/interrupt.h
+License:  GNU General Public License v3
+
+    Interrupt handlers become plain functions that the host HAL calls from
+    its virtual clock.  sei()/cli() gate that dispatch.
+
+*************************************************************************/
+
+#ifndef _HOST_AVR_INTERRUPT_H_
+#define _HOST_AVR_INTERRUPT_H_
+
+#include <stdbool.h>
+
+extern volatile bool halHostInterruptsEnabled;
+
+#define ISR(vector, ...)  void vector(void); void vector(void)
+#define sei()  do { halHostInterruptsEnabled = true; } while(0)
+#define cli()  do { halHostInterruptsEnabled = false; } while(0)
+
+#endif
@@ -0,0 +1,36 @@
+/*************************************************************************
+Title:    Host stand-in for <avr/io.h>
+File:     host/avr/io.h
+License:  GNU General Public License v3
+
+    Only the bit helpers and pin numbers are provided.  Register access
+    belongs in the HAL (see hal.h), so using a register here is a build error.
+
+*************************************************************************/
+
+#ifndef _HOST_AVR_IO_H_
+#define _HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PA3 3
+#define PA4 4
+#define PA5 5
+#define PA6 6
+#define PA7 7
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+
+#endif
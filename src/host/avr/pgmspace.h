@@ -0,0 +1,19 @@
+/*************************************************************************
+Title:    Host stand-in for <avr/pgmspace.h>
+File:     host/avr/pgmspace.h
+License:  GNU General Public License v3
+
+*************************************************************************/
+
+#ifndef _HOST_AVR_PGMSPACE_H_
+#define _HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+
+#define PROGMEM
+#define pgm_read_byte(addr)   (*(const uint8_t*)(addr))
+#define pgm_read_word(addr)   (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr)  (*(const uint32_t*)(addr))
+#define pgm_read_ptr(addr)    (*(const void* const*)(addr))
+
+#endif
@@ -0,0 +1,18 @@
+/*************************************************************************
+Title:    Host stand-in for <avr/wdt.h>
+File:     host/avr/wdt.h
+License:  GNU General Public License v3
+
+    The firmware pets the watchdog everywhere it makes progress, so the host
+    HAL uses each wdt_reset() as the point where virtual time moves forward.
+
+*************************************************************************/
+
+#ifndef _HOST_AVR_WDT_H_
+#define _HOST_AVR_WDT_H_
+
+void halHostWatchdogReset(void);
+
+#define wdt_reset()  halHostWatchdogReset()
+
+#endif
@@ -0,0 +1,247 @@
+/*************************************************************************
+Title:    CKT-IIAB Delay Profile Specification
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     host/delaySpec.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "delay.h"
+#include "delaySpec.h"
+
+DelaySpec_t delaySpec[DELAY_SPEC_SETTINGS];
+
+static const char* specName;
+static unsigned int specLine;
+
+static bool specError(const char* message)
+{
+	fprintf(stderr, "%s:%u: %s\n", specName, specLine, message);
+	return false;
+}
+
+static bool addPart(DelaySpec_t* p, DelayPartKind_t kind, double weight, double lo, double hi, double mode)
+{
+	DelaySpecPart_t* part;
+
+	if (weight <= 0)
+		return true;
+	if (p->count >= DELAY_SPEC_MAX_PARTS)
+		return specError("too many parts");
+	if (lo < 0 || hi < lo || hi * (1 << DELAY_PROFILE_FRACTION_BITS) > UINT16_MAX)
+		return specError("delay out of range (0-511 seconds)");
+
+	part = &p->part[p->count++];
+	part->kind = kind;
+	part->weight = weight;
+	part->lo = lo;
+	part->hi = hi;
+	part->mode = mode;
+	return true;
+}
+
+static bool parsePart(DelaySpec_t* p, char* text)
+{
+	char kind[32];
+	double weight, a = 0, b = 0, c = 0;
+	int n = sscanf(text, "%lf %31s %lf %lf %lf", &weight, kind, &a, &b, &c);
+
+	if (n < 2 || weight < 0)
+		return specError("expected 'weight kind args'");
+
+	if (0 == strcmp(kind, "none") && 2 == n)
+		return addPart(p, DELAY_PART_NONE, weight, DELAY_NONE_SECONDS, DELAY_NONE_SECONDS, 0);
+	if (0 == strcmp(kind, "fixed") && 3 == n)
+		return addPart(p, DELAY_PART_FIXED, weight, a, a, 0);
+	if (0 == strcmp(kind, "uniform") && 4 == n)
+	{
+		if (b < a || a != floor(a) || b != floor(b))
+			return specError("uniform needs whole seconds MIN <= MAX");
+		return addPart(p, DELAY_PART_UNIFORM, weight, a, b + 1, 0);
+	}
+	if (0 == strcmp(kind, "triangular") && 5 == n)
+	{
+		if (!(a <= b && b <= c && a < c))
+			return specError("triangular needs MIN <= MODE <= MAX");
+		return addPart(p, DELAY_PART_TRIANGULAR, weight, a, c, b);
+	}
+	if (0 == strcmp(kind, "exponential") && 5 == n)
+	{
+		if (!(b > 0 && c > a))
+			return specError("exponential needs MEAN > 0 and MAX > MIN");
+		return addPart(p, DELAY_PART_EXPONENTIAL, weight, a, c, b);
+	}
+	return specError("unknown kind or wrong number of arguments");
+}
+
+static bool parseLine(char* line)
+{
+	char source[DELAY_SPEC_MAX_LINE];
+	char* hash = strchr(line, '#');
+	char* text;
+	char* save;
+	char* end;
+	double total = 0;
+	uint8_t i;
+
+	if (hash)
+		*hash = 0;
+	line[strcspn(line, "\r\n")] = 0;
+	if (strspn(line, " \t") == strlen(line))
+		return true;
+
+	strncpy(source, line + strspn(line, " \t"), sizeof(source) - 1);
+	source[sizeof(source) - 1] = 0;
+
+	text = strtok_r(line, "|", &save);
+	long setting = strtol(text, &end, 10);
+	if (end == text || strspn(end, " \t") != strlen(end) || setting < 0 || setting >= DELAY_SPEC_SETTINGS)
+		return specError("expected a setting from 0 to 15 before the first '|'");
+
+	DelaySpec_t* p = &delaySpec[setting];
+	if (p->defined)
+		return specError("setting defined twice");
+	p->defined = true;
+	strcpy(p->source, source);
+
+	while ((text = strtok_r(NULL, "|", &save)))
+		if (!parsePart(p, text))
+			return false;
+
+	if (0 == p->count)
+		return specError("no delay parts with any weight");
+
+	// Weights are relative, make them fractions of the draws
+	for (i = 0; i < p->count; i++)
+		total += p->part[i].weight;
+	for (i = 0; i < p->count; i++)
+		p->part[i].weight /= total;
+	return true;
+}
+
+bool delaySpecLoad(const char* path)
+{
+	char line[DELAY_SPEC_MAX_LINE];
+	unsigned int setting;
+	bool ok = true;
+	FILE* in;
+
+	memset(delaySpec, 0, sizeof(delaySpec));
+	specName = path;
+	specLine = 0;
+
+	in = fopen(path, "r");
+	if (!in)
+	{
+		perror(path);
+		return false;
+	}
+	while (ok && fgets(line, sizeof(line), in))
+	{
+		specLine++;
+		ok = parseLine(line);
+	}
+	fclose(in);
+	if (!ok)
+		return false;
+
+	for (setting = 0; setting < DELAY_SPEC_SETTINGS; setting++)
+	{
+		if (!delaySpec[setting].defined)
+		{
+			fprintf(stderr, "%s: no profile for setting %u\n", path, setting);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Untruncated curves
+static double triangularCDF(double x, double a, double c, double b)
+{
+	if (x <= a)
+		return 0.0;
+	if (x >= b)
+		return 1.0;
+	if (x <= c)
+		return (x - a) * (x - a) / ((b - a) * (c - a));
+	return 1.0 - (b - x) * (b - x) / ((b - a) * (b - c));
+}
+
+static double exponentialCDF(double x, double min, double mean)
+{
+	if (x <= min)
+		return 0.0;
+	return 1.0 - exp(-(x - min) / mean);
+}
+
+double delaySpecPartCDF(const DelaySpecPart_t* part, double x)
+{
+	if (x <= part->lo)
+		return 0.0;
+	if (x > part->hi || (x == part->hi && part->hi > part->lo))
+		return 1.0;
+
+	switch(part->kind)
+	{
+		case DELAY_PART_UNIFORM:
+			return (x - part->lo) / (part->hi - part->lo);
+
+		case DELAY_PART_TRIANGULAR:
+			return triangularCDF(x, part->lo, part->mode, part->hi);
+
+		case DELAY_PART_EXPONENTIAL:
+			// Cut off at MAX, the rest spread over what's left
+			return exponentialCDF(x, part->lo, part->mode) / exponentialCDF(part->hi, part->lo, part->mode);
+
+		default:
+			return 1.0;  // Exact delays are all at lo
+	}
+}
+
+double delaySpecCDF(uint8_t setting, double x)
+{
+	const DelaySpec_t* p = &delaySpec[setting % DELAY_SPEC_SETTINGS];
+	double cdf = 0;
+	uint8_t i;
+
+	for (i = 0; i < p->count; i++)
+		cdf += p->part[i].weight * delaySpecPartCDF(&p->part[i], x);
+	return cdf;
+}
+
+double delaySpecSecondsCDF(uint8_t setting, double s)
+{
+	if (s < 0)
+		return 0.0;
+	return delaySpecCDF(setting, floor(s) + 1);
+}
+
+bool delaySpecExact(uint8_t setting)
+{
+	const DelaySpec_t* p = &delaySpec[setting % DELAY_SPEC_SETTINGS];
+	uint8_t i;
+
+	for (i = 0; i < p->count; i++)
+		if (DELAY_PART_TRIANGULAR == p->part[i].kind || DELAY_PART_EXPONENTIAL == p->part[i].kind)
+			return false;
+	return true;
+}
@@ -0,0 +1,87 @@
+/*************************************************************************
+Title:    CKT-IIAB Delay Profile Specification
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     host/delaySpec.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _DELAY_SPEC_H_
+#define _DELAY_SPEC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// What each delay DIP setting is supposed to do with random delays enabled,
+//  read from the same profile description host/delaygen builds the firmware
+//  tables from (delayProfiles.txt, format described there).  With random
+//  off, setting n is a fixed 5n seconds.
+// Shared by the host tools that generate the tables and check the firmware
+//  and the fixture logs against them.
+
+#define DELAY_SPEC_SETTINGS     16
+#define DELAY_SPEC_FIXED_STEP   5
+#define DELAY_SPEC_MAX_PARTS    16
+#define DELAY_SPEC_MAX_LINE     512
+#define DELAY_SPEC_FILE         "delayProfiles.txt"
+
+typedef enum
+{
+	DELAY_PART_NONE,
+	DELAY_PART_FIXED,
+	DELAY_PART_UNIFORM,
+	DELAY_PART_TRIANGULAR,
+	DELAY_PART_EXPONENTIAL,
+} DelayPartKind_t;
+
+typedef struct
+{
+	DelayPartKind_t kind;
+	double weight;    // Fraction of the setting's draws
+	double lo;        // Delays covered, [lo, hi) seconds.  lo == hi for an
+	double hi;        //  exact delay, hi is MAX + 1 for uniform whole seconds.
+	double mode;      // Triangular peak, or exponential mean
+} DelaySpecPart_t;
+
+typedef struct
+{
+	bool defined;
+	char source[DELAY_SPEC_MAX_LINE];
+	uint8_t count;
+	DelaySpecPart_t part[DELAY_SPEC_MAX_PARTS];
+} DelaySpec_t;
+
+extern DelaySpec_t delaySpec[DELAY_SPEC_SETTINGS];
+
+// Reads every setting's profile, reporting any problem on stderr
+bool delaySpecLoad(const char* path);
+
+// Probability that a part's delay (continuous, seconds) is under x
+double delaySpecPartCDF(const DelaySpecPart_t* part, double x);
+
+// Probability that a setting's delay is under x seconds
+double delaySpecCDF(uint8_t setting, double x);
+
+// Probability that a setting's delay, counted in whole seconds as the
+//  firmware waits it out, is at or below s
+double delaySpecSecondsCDF(uint8_t setting, double s);
+
+// True if every part of the setting is exact or flat, so the firmware's
+//  table matches it exactly rather than in pieces
+bool delaySpecExact(uint8_t setting);
+
+#endif
@@ -0,0 +1,257 @@
+/*************************************************************************
+Title:    CKT-IIAB Delay Profile Generator
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     host/delaygen.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+// Turns delayProfiles.txt into delayProfiles.h - the PROGMEM inverse CDF
+// segments and guide tables delaySelectSeconds() samples from (see delay.h).
+// The description is read by delaySpec.c, the same as the tools that check
+// the firmware.
+//
+// Exact delays and whole-second uniform ranges come out as a single segment
+// each.  Triangular and exponential parts are cut wherever they cross a guide
+// cell edge, so every piece is an equal share of the draws and the curve is
+// followed by joining up its inverse CDF at the cuts.  Each setting gets the
+// fewest guide cells (a power of two, DELAYGEN_MAX_BITS at most) that leave
+// no cell holding more than one segment end and keep every curve within
+// DELAYGEN_MAX_ERROR of its CDF.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "delay.h"
+#include "delaySpec.h"
+
+#define DELAYGEN_MAX_BITS      7        // Up to 128 guide cells
+#define DELAYGEN_MAX_SEGMENTS  ((1 << DELAYGEN_MAX_BITS) + 2 * DELAY_SPEC_MAX_PARTS)
+#define DELAYGEN_MAX_ERROR     0.002    // CDF error allowed where a curve is cut into pieces
+#define DELAYGEN_U             65536
+#define DELAYGEN_TICKS         (1 << DELAY_PROFILE_FRACTION_BITS)
+
+typedef struct
+{
+	uint32_t uStart;   // Share of the draws, [uStart, uEnd) of DELAYGEN_U
+	uint32_t uEnd;
+	double vStart;     // Seconds
+	double vEnd;
+} GenSegment_t;
+
+typedef struct
+{
+	uint8_t bits;
+	uint16_t count;
+	double error;
+	GenSegment_t segment[DELAYGEN_MAX_SEGMENTS];
+	uint8_t guide[1 << DELAYGEN_MAX_BITS];
+} GenProfile_t;
+
+static GenProfile_t profiles[DELAY_SPEC_SETTINGS];
+
+static bool isCurve(const DelaySpecPart_t* part)
+{
+	return DELAY_PART_TRIANGULAR == part->kind || DELAY_PART_EXPONENTIAL == part->kind;
+}
+
+// Delay a fraction f of the way through a part's draws
+static double partInverse(const DelaySpecPart_t* part, double f)
+{
+	double lo = part->lo, hi = part->hi;
+	int i;
+
+	if (f <= 0)
+		return part->lo;
+	if (f >= 1)
+		return part->hi;
+	for (i = 0; i < 60; i++)
+	{
+		double mid = (lo + hi) / 2;
+		if (delaySpecPartCDF(part, mid) < f)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return (lo + hi) / 2;
+}
+
+static void addSegment(GenProfile_t* p, uint32_t uStart, uint32_t uEnd, double vStart, double vEnd)
+{
+	if (uEnd <= uStart)
+		return;  // Too unlikely to get any draws
+	p->segment[p->count].uStart = uStart;
+	p->segment[p->count].uEnd = uEnd;
+	p->segment[p->count].vStart = vStart;
+	p->segment[p->count].vEnd = vEnd;
+	p->count++;
+}
+
+static void addCurve(GenProfile_t* p, const DelaySpecPart_t* part, uint32_t uStart, uint32_t uEnd)
+{
+	uint32_t cell = DELAYGEN_U >> p->bits;
+	uint32_t a = uStart, b;
+
+	while (a < uEnd)
+	{
+		b = (a / cell + 1) * cell;
+		if (b > uEnd)
+			b = uEnd;
+
+		double fa = (double)(a - uStart) / (uEnd - uStart);
+		double fb = (double)(b - uStart) / (uEnd - uStart);
+		double va = partInverse(part, fa), vb = partInverse(part, fb);
+
+		// The firmware spreads the piece evenly, so check how far the curve
+		//  strays from a straight line halfway across it
+		double error = part->weight * fabs(delaySpecPartCDF(part, (va + vb) / 2) - (fa + fb) / 2);
+		if (error > p->error)
+			p->error = error;
+
+		addSegment(p, a, b, va, vb);
+		a = b;
+	}
+}
+
+// Lays out the segments for 1 << bits guide cells, false if a cell would
+//  hold more than one segment end
+static bool buildProfile(GenProfile_t* p, const DelaySpec_t* spec, uint8_t bits)
+{
+	uint32_t cell = DELAYGEN_U >> bits;
+	uint32_t c, uStart = 0, uEnd;
+	double cumulative = 0;
+	uint16_t g = 0, h;
+	uint8_t i;
+
+	p->bits = bits;
+	p->count = 0;
+	p->error = 0;
+
+	for (i = 0; i < spec->count; i++)
+	{
+		const DelaySpecPart_t* part = &spec->part[i];
+
+		cumulative += part->weight;
+		uEnd = (i == spec->count - 1) ? DELAYGEN_U : (uint32_t)lround(cumulative * DELAYGEN_U);
+
+		if (isCurve(part))
+			addCurve(p, part, uStart, uEnd);
+		else
+			addSegment(p, uStart, uEnd, part->lo, part->hi);
+		uStart = uEnd;
+	}
+
+	for (c = 0; c < (1UL << bits); c++)
+	{
+		while (p->segment[g].uEnd <= c * cell)
+			g++;
+		for (h = g; p->segment[h].uEnd < (c + 1) * cell; h++);
+		if (h > g + 1)
+			return false;
+		p->guide[c] = g;
+	}
+	return true;
+}
+
+static void writeProfile(FILE* out, unsigned int setting, const GenProfile_t* p, const char* source)
+{
+	uint16_t i;
+
+	fprintf(out, "// %s\n", source);
+	fprintf(out, "static const DelaySegment_t delayProfile%u[] PROGMEM =\n{\n", setting);
+	for (i = 0; i < p->count; i++)
+	{
+		const GenSegment_t* s = &p->segment[i];
+		long vStart = lround(s->vStart * DELAYGEN_TICKS);
+		long vEnd = lround(s->vEnd * DELAYGEN_TICKS);
+
+		fprintf(out, "\t{ %5u, %5ld, %5ld },  // %7.3f%%  %.3f - %.3fs\n", s->uEnd - 1, vStart, vEnd - vStart,
+			100.0 * (s->uEnd - s->uStart) / DELAYGEN_U, s->vStart, s->vEnd);
+	}
+	fprintf(out, "};\n\n");
+
+	fprintf(out, "static const uint8_t delayGuide%u[] PROGMEM =\n{", setting);
+	for (i = 0; i < (1U << p->bits); i++)
+		fprintf(out, "%s%3u,", (i % 16) ? " " : "\n\t", p->guide[i]);
+	fprintf(out, "\n};\n\n");
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int setting;
+	FILE* out;
+
+	if (argc != 3)
+	{
+		fprintf(stderr, "Usage: %s delayProfiles.txt delayProfiles.h\n", argv[0]);
+		return 2;
+	}
+
+	if (!delaySpecLoad(argv[1]))
+		return 1;
+	for (setting = 0; setting < DELAY_SPEC_SETTINGS; setting++)
+	{
+		GenProfile_t* p = &profiles[setting];
+		bool fits = false;
+		uint8_t bits;
+
+		for (bits = 0; bits <= DELAYGEN_MAX_BITS; bits++)
+		{
+			fits = buildProfile(p, &delaySpec[setting], bits);
+			if (fits && p->error <= DELAYGEN_MAX_ERROR)
+				break;
+		}
+		if (!fits)
+		{
+			fprintf(stderr, "%s: setting %u has parts too close together to look up, "
+				"give each at least 1/%u of the draws\n", argv[1], setting, 1 << DELAYGEN_MAX_BITS);
+			return 1;
+		}
+		if (p->error > DELAYGEN_MAX_ERROR)
+			fprintf(stderr, "%s: setting %u curves are only followed to within %.4f\n", argv[1], setting, p->error);
+	}
+
+	out = fopen(argv[2], "w");
+	if (!out)
+	{
+		perror(argv[2]);
+		return 1;
+	}
+
+	fprintf(out, "// Generated by host/delaygen from %s - do not edit, run \"make profiles\"\n\n", argv[1]);
+	fprintf(out, "#ifndef _DELAY_PROFILES_H_\n#define _DELAY_PROFILES_H_\n\n");
+	fprintf(out, "#include <avr/pgmspace.h>\n#include \"delay.h\"\n\n");
+	fprintf(out, "// { uLast, vStart, vSpan } and guide cells - see delay.h\n\n");
+
+	for (setting = 0; setting < DELAY_SPEC_SETTINGS; setting++)
+		writeProfile(out, setting, &profiles[setting], delaySpec[setting].source);
+
+	fprintf(out, "static const DelayProfile_t delayProfiles[DELAY_PROFILE_SETTINGS] PROGMEM =\n{\n");
+	for (setting = 0; setting < DELAY_SPEC_SETTINGS; setting++)
+		fprintf(out, "\t{ delayProfile%u, delayGuide%u, %u },\n", setting, setting, 8 - profiles[setting].bits);
+	fprintf(out, "};\n\n#endif\n");
+
+	if (fclose(out))
+	{
+		perror(argv[2]);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,413 @@
+/*************************************************************************
+Title:    CKT-IIAB Delay Test Log Analyzer
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     host/delaylog.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+// Reads the "index,millis" logs from iiab-delay-test (or ckt-iiab-host) in a
+// single pass.  Everything is accumulated into a fixed 10ms histogram, so a
+// log of any length runs in the same memory.  Reports:
+//  - count, min / max / mean / standard deviation and percentiles
+//  - a histogram and the modes found in it (the "no delay" spike, the range)
+//  - which delay DIP setting the distribution matches, by the Kolmogorov-Smirnov
+//    distance to each setting in the profile description (delayProfiles.txt,
+//    read with delaySpec.c the same way host/delaygen builds the tables)
+//
+// The fixture adds its own ~100-200ms to every train, and older firmware only
+// counted the delay in whole seconds (up to a second short), so the log is
+// allowed to be up to a second either side of the spec before it counts as
+// a mismatch.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include "delay.h"
+#include "delaySpec.h"
+
+#define DELAYLOG_BIN_MS        10
+#define DELAYLOG_MAX_MS        400000
+#define DELAYLOG_BINS          (DELAYLOG_MAX_MS / DELAYLOG_BIN_MS)    // Plus one for overflow
+#define DELAYLOG_HIST_ROWS     40
+#define DELAYLOG_HIST_WIDTH    50
+#define DELAYLOG_MODE_FRACTION 0.002   // 1s bins holding at least this much of the log are part of a mode
+#define DELAYLOG_MODE_GAP      1       // Empty seconds allowed inside one mode
+#define DELAYLOG_SLACK_S       1.0     // Timing slop allowed against the spec
+#define DELAYLOG_CANDIDATES    (2 * DELAY_SPEC_SETTINGS)
+
+typedef struct
+{
+	uint64_t count;
+	uint64_t malformed;
+	uint64_t gaps;
+	uint32_t min;
+	uint32_t max;
+	double sum;
+	double sumSquares;
+	uint64_t bins[DELAYLOG_BINS + 1];
+} DelayLog_t;
+
+typedef struct
+{
+	bool randomized;
+	uint8_t setting;
+	double distance;
+} DelayMatch_t;
+
+static DelayLog_t delayLog;
+
+static void logInitialize(DelayLog_t* log)
+{
+	memset(log, 0, sizeof(*log));
+	log->min = UINT32_MAX;
+}
+
+static void logAdd(DelayLog_t* log, uint32_t ms)
+{
+	uint32_t bin = ms / DELAYLOG_BIN_MS;
+
+	if (bin > DELAYLOG_BINS)
+		bin = DELAYLOG_BINS;
+	log->bins[bin]++;
+	log->count++;
+	log->sum += ms;
+	log->sumSquares += (double)ms * ms;
+	if (ms < log->min)
+		log->min = ms;
+	if (ms > log->max)
+		log->max = ms;
+}
+
+static bool logRead(DelayLog_t* log, FILE* f)
+{
+	char line[128];
+	bool first = true;
+	unsigned long lastIndex = 0;
+
+	while (fgets(line, sizeof(line), f))
+	{
+		unsigned long index, ms;
+		char extra;
+
+		// A line too long for the buffer is junk from a noisy serial link; skip the rest of it
+		if (!strchr(line, '\n') && !feof(f))
+		{
+			int c;
+			while ((c = fgetc(f)) != EOF && c != '\n');
+			log->malformed++;
+			continue;
+		}
+
+		if (2 != sscanf(line, "%lu,%lu %c", &index, &ms, &extra))
+		{
+			if (strspn(line, " \t\r\n") != strlen(line))
+				log->malformed++;
+			continue;
+		}
+
+		// The fixture counts up from 0; anything else is a dropped line or a restart
+		if (!first && index != lastIndex + 1)
+			log->gaps++;
+		first = false;
+		lastIndex = index;
+
+		logAdd(log, ms);
+	}
+
+	return !ferror(f);
+}
+
+// Smallest latency with at least fraction p of the log at or below it
+static uint32_t logPercentile(const DelayLog_t* log, double p)
+{
+	uint64_t target = (uint64_t)ceil(p * log->count);
+	uint64_t count = 0;
+	uint32_t bin;
+
+	if (0 == target)
+		target = 1;
+
+	for (bin = 0; bin <= DELAYLOG_BINS; bin++)
+	{
+		count += log->bins[bin];
+		if (count >= target)
+			return bin * DELAYLOG_BIN_MS;
+	}
+	return DELAYLOG_MAX_MS;
+}
+
+// Log count in whole second s
+static uint64_t logSecond(const DelayLog_t* log, uint32_t s)
+{
+	uint32_t perSecond = 1000 / DELAYLOG_BIN_MS;
+	uint32_t bin = s * perSecond;
+	uint64_t count = 0;
+	uint32_t i;
+
+	for (i = 0; i < perSecond && bin + i <= DELAYLOG_BINS; i++)
+		count += log->bins[bin + i];
+	return count;
+}
+
+static void logPrintHistogram(const DelayLog_t* log)
+{
+	uint32_t first = log->min / 1000, last = log->max / 1000;
+	uint32_t width, row, s;
+	uint64_t peak = 0;
+
+	if (last > DELAYLOG_MAX_MS / 1000)
+		last = DELAYLOG_MAX_MS / 1000;
+	width = (last - first + DELAYLOG_HIST_ROWS) / DELAYLOG_HIST_ROWS;
+
+	for (row = first; row <= last; row += width)
+	{
+		uint64_t count = 0;
+		for (s = row; s < row + width; s++)
+			count += logSecond(log, s);
+		if (count > peak)
+			peak = count;
+	}
+
+	printf("Histogram (%us bins):\n", width);
+	for (row = first; row <= last; row += width)
+	{
+		uint64_t count = 0;
+		int bar;
+
+		for (s = row; s < row + width; s++)
+			count += logSecond(log, s);
+		bar = peak ? (int)(count * DELAYLOG_HIST_WIDTH / peak) : 0;
+
+		printf("  %6.1fs  %7.3f%% ", row + width / 2.0, 100.0 * count / log->count);
+		while (bar--)
+			putchar('#');
+		putchar('\n');
+	}
+}
+
+// A mode is a run of busy seconds, allowing for a short empty stretch inside it
+static void logPrintModes(const DelayLog_t* log)
+{
+	uint64_t threshold = (uint64_t)ceil(DELAYLOG_MODE_FRACTION * log->count);
+	uint32_t last = DELAYLOG_MAX_MS / 1000;
+	uint32_t s = 0, mode = 0;
+
+	if (threshold < 2)
+		threshold = 2;
+
+	printf("Modes:\n");
+	while (s <= last)
+	{
+		if (logSecond(log, s) < threshold)
+		{
+			s++;
+			continue;
+		}
+
+		uint32_t start = s, end = s, quiet = 0;
+		uint64_t count = 0;
+		double sum = 0;
+
+		for (; s <= last && quiet <= DELAYLOG_MODE_GAP; s++)
+		{
+			uint64_t c = logSecond(log, s);
+			if (c >= threshold)
+			{
+				end = s;
+				quiet = 0;
+			}
+			else
+				quiet++;
+		}
+		for (uint32_t i = start; i <= end; i++)
+		{
+			uint64_t c = logSecond(log, i);
+			count += c;
+			sum += c * (i + 0.5);
+		}
+
+		mode++;
+		if (start == end)
+			printf("  %u: spike at %us, %.2f%% of trains\n", mode, start, 100.0 * count / log->count);
+		else
+			printf("  %u: %u-%us, mean %.1fs, %.2f%% of trains\n", mode, start, end + 1, sum / count, 100.0 * count / log->count);
+	}
+	if (0 == mode)
+		printf("  none\n");
+}
+
+// Probability that a setting's delay is at or below s seconds
+static double modelCDF(const DelayMatch_t* m, double s)
+{
+	if (!m->randomized)
+		return (s >= m->setting * DELAY_SPEC_FIXED_STEP) ? 1.0 : 0.0;
+
+	return delaySpecSecondsCDF(m->setting, s);
+}
+
+// Kolmogorov-Smirnov distance, except the log only counts as off the model
+//  where it's outside the model shifted DELAYLOG_SLACK_S either way
+static double logDistance(const DelayLog_t* log, const DelayMatch_t* m)
+{
+	uint64_t count = 0;
+	double distance = 0;
+	uint32_t bin;
+
+	for (bin = 0; bin <= DELAYLOG_BINS; bin++)
+	{
+		if (0 == log->bins[bin])
+			continue;
+
+		// Check both sides of the step the log's CDF takes in this bin
+		double before = (double)count / log->count;
+		count += log->bins[bin];
+		double after = (double)count / log->count;
+		double start = (double)bin * DELAYLOG_BIN_MS / 1000.0;
+		double end = (double)(bin + 1) * DELAYLOG_BIN_MS / 1000.0;
+
+		double d1 = modelCDF(m, start - DELAYLOG_SLACK_S) - before;
+		double d2 = after - modelCDF(m, end + DELAYLOG_SLACK_S);
+
+		if (d1 > distance)
+			distance = d1;
+		if (d2 > distance)
+			distance = d2;
+	}
+	return distance;
+}
+
+static int matchCompare(const void* a, const void* b)
+{
+	double da = ((const DelayMatch_t*)a)->distance, db = ((const DelayMatch_t*)b)->distance;
+	return (da > db) - (da < db);
+}
+
+static bool logPrintMatch(const DelayLog_t* log, int shown)
+{
+	DelayMatch_t match[DELAYLOG_CANDIDATES];
+	double critical = 1.36 / sqrt((double)log->count);  // 5% level
+	int i;
+
+	for (i = 0; i < DELAYLOG_CANDIDATES; i++)
+	{
+		match[i].randomized = (i >= DELAY_SPEC_SETTINGS);
+		match[i].setting = i % DELAY_SPEC_SETTINGS;
+		match[i].distance = logDistance(log, &match[i]);
+	}
+	qsort(match, DELAYLOG_CANDIDATES, sizeof(match[0]), matchCompare);
+
+	printf("Closest DIP settings (KS distance with %.0fs slack, %.4f needed at 5%%):\n", DELAYLOG_SLACK_S, critical);
+	for (i = 0; i < shown && i < DELAYLOG_CANDIDATES; i++)
+		printf("  %-6s %2u  D = %.4f\n", match[i].randomized ? "random" : "fixed", match[i].setting, match[i].distance);
+
+	bool matched = match[0].distance <= critical;
+	printf("Result: %s %s delay setting %u\n", matched ? "matches" : "closest to (but does not match)",
+		match[0].randomized ? "random" : "fixed", match[0].setting);
+	return matched;
+}
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [-m matches] [-p profiles] [-q] [logfile ...]\n", name);
+	fprintf(stderr, "  Reads stdin when no log file is given; several files are analysed as one log\n");
+	fprintf(stderr, "  -m matches   Number of closest DIP settings to list (default 3)\n");
+	fprintf(stderr, "  -p profiles  Profile description to match against (default %s)\n", DELAY_SPEC_FILE);
+	fprintf(stderr, "  -q           Skip the histogram\n");
+}
+
+int main(int argc, char** argv)
+{
+	const char* profiles = DELAY_SPEC_FILE;
+	int shown = 3;
+	bool histogram = true;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "m:p:qh")) != -1)
+	{
+		switch(opt)
+		{
+			case 'm':
+				shown = atoi(optarg);
+				break;
+			case 'p':
+				profiles = optarg;
+				break;
+			case 'q':
+				histogram = false;
+				break;
+			default:
+				usage(argv[0]);
+				return 2;
+		}
+	}
+
+	if (!delaySpecLoad(profiles))
+		return 2;
+
+	logInitialize(&delayLog);
+
+	if (optind >= argc)
+	{
+		if (!logRead(&delayLog, stdin))
+		{
+			perror("stdin");
+			return 2;
+		}
+	}
+	for (; optind < argc; optind++)
+	{
+		FILE* f = fopen(argv[optind], "r");
+		if (!f || !logRead(&delayLog, f))
+		{
+			perror(argv[optind]);
+			return 2;
+		}
+		fclose(f);
+	}
+
+	if (0 == delayLog.count)
+	{
+		fprintf(stderr, "No samples\n");
+		return 2;
+	}
+
+	double mean = delayLog.sum / delayLog.count;
+	double variance = delayLog.sumSquares / delayLog.count - mean * mean;
+
+	printf("Trains: %llu  (%llu malformed lines, %llu index gaps)\n",
+		(unsigned long long)delayLog.count, (unsigned long long)delayLog.malformed, (unsigned long long)delayLog.gaps);
+	printf("Latency: min %.3fs  max %.3fs  mean %.3fs  std dev %.3fs\n",
+		delayLog.min / 1000.0, delayLog.max / 1000.0, mean / 1000.0, sqrt(variance > 0 ? variance : 0) / 1000.0);
+	printf("Percentiles: p1 %.2fs  p5 %.2fs  p25 %.2fs  p50 %.2fs  p75 %.2fs  p95 %.2fs  p99 %.2fs\n",
+		logPercentile(&delayLog, 0.01) / 1000.0, logPercentile(&delayLog, 0.05) / 1000.0,
+		logPercentile(&delayLog, 0.25) / 1000.0, logPercentile(&delayLog, 0.50) / 1000.0,
+		logPercentile(&delayLog, 0.75) / 1000.0, logPercentile(&delayLog, 0.95) / 1000.0,
+		logPercentile(&delayLog, 0.99) / 1000.0);
+	if (delayLog.max >= DELAYLOG_MAX_MS)
+		printf("Note: latencies over %us are counted at %us\n", DELAYLOG_MAX_MS / 1000, DELAYLOG_MAX_MS / 1000);
+
+	if (histogram)
+		logPrintHistogram(&delayLog);
+	logPrintModes(&delayLog);
+
+	return logPrintMatch(&delayLog, shown) ? 0 : 1;
+}
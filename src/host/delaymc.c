@@ -0,0 +1,318 @@
+/*************************************************************************
+Title:    CKT-IIAB Delay Profile Monte Carlo Validator
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     host/delaymc.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+// Draws samples straight from the firmware's delaySelectSeconds() (delay.c)
+// for every delay DIP setting and checks them against the profile
+// description in delayProfiles.txt, read with delaySpec.c the same way
+// host/delaygen reads it to build the tables.  Replaces logging thousands of
+// trains off real hardware with iiab-delay-test and a spreadsheet.
+//
+// Each randomized setting has to:
+//  - only produce delays the description gives any chance to
+//  - follow the described CDF, whole second by whole second, to within
+//    DELAYMC_SIGMAS standard deviations (plus DELAYMC_PIECE_SLACK where
+//    delaygen had to cut a curve into pieces)
+//  - for settings made only of exact delays and flat ranges, which the
+//    tables reproduce exactly, also pass chi-squared against the expected
+//    count for every second (chi2 is only shown, marked *, for the others)
+//  - for the bimodal settings (any "none" part), land on DELAY_NONE_SECONDS
+//    as often as described, to within DELAYMC_SIGMAS standard deviations,
+//    so a drifting no-delay spike fails on its own
+// "ks" is the worst CDF gap over what's allowed, so anything over 1 fails.
+// Fixed settings have to give exactly 5 seconds per step.
+// Exits 1 if anything drifts from the spec.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include "delay.h"
+#include "prng.h"
+#include "delaySpec.h"
+
+#define DELAYMC_MAX_SECONDS  (UINT16_MAX >> DELAY_PROFILE_FRACTION_BITS)
+#define DELAYMC_SIGMAS       6.0
+#define DELAYMC_PIECE_SLACK  0.005
+#define DELAYMC_CHI2_MIN     5.0
+#define DELAYMC_HIST_BINS    20
+#define DELAYMC_HIST_WIDTH   50
+
+static uint64_t hist[DELAYMC_MAX_SECONDS + 2];
+
+static uint32_t percentile(uint64_t samples, double p)
+{
+	uint64_t target = (uint64_t)ceil(p * samples);
+	uint64_t count = 0;
+	uint32_t s;
+
+	for (s = 0; s <= DELAYMC_MAX_SECONDS + 1; s++)
+	{
+		count += hist[s];
+		if (count >= target && count)
+			return s;
+	}
+	return DELAYMC_MAX_SECONDS + 1;
+}
+
+// True if the setting has a "none" part, the no-delay spike of the bimodal
+//  LOW/MID/HIGH modes
+static bool hasNoDelay(uint8_t setting)
+{
+	const DelaySpec_t* spec = &delaySpec[setting];
+	uint8_t i;
+
+	for (i = 0; i < spec->count; i++)
+		if (DELAY_PART_NONE == spec->part[i].kind)
+			return true;
+	return false;
+}
+
+// Chance of exactly s whole seconds
+static double expectedMass(uint8_t setting, uint32_t s)
+{
+	return delaySpecSecondsCDF(setting, s) - delaySpecSecondsCDF(setting, (double)s - 1);
+}
+
+static void printHistogram(uint8_t setting, uint32_t first, uint32_t last, uint64_t samples)
+{
+	uint32_t binWidth = (last - first + DELAYMC_HIST_BINS) / DELAYMC_HIST_BINS;
+	uint64_t bins[DELAYMC_HIST_BINS];
+	double expected[DELAYMC_HIST_BINS];
+	uint64_t peak = 0;
+	uint32_t b, s;
+
+	memset(bins, 0, sizeof(bins));
+	memset(expected, 0, sizeof(expected));
+	for (s = first; s <= last; s++)
+	{
+		bins[(s - first) / binWidth] += hist[s];
+		expected[(s - first) / binWidth] += expectedMass(setting, s);
+	}
+
+	for (b = 0; b < DELAYMC_HIST_BINS; b++)
+		if (bins[b] > peak)
+			peak = bins[b];
+
+	for (b = 0; b < DELAYMC_HIST_BINS; b++)
+	{
+		uint32_t lo = first + b * binWidth;
+		uint32_t hi = lo + binWidth - 1;
+		int width = peak ? (int)(bins[b] * DELAYMC_HIST_WIDTH / peak) : 0;
+
+		if (lo > last)
+			break;
+		if (hi > last)
+			hi = last;
+		if (lo == hi)
+			printf("        %3us     %6.2f%% (%6.2f%%) ", lo, 100.0 * bins[b] / samples, 100.0 * expected[b]);
+		else
+			printf("    %3u-%-3us     %6.2f%% (%6.2f%%) ", lo, hi, 100.0 * bins[b] / samples, 100.0 * expected[b]);
+		while (width--)
+			putchar('#');
+		putchar('\n');
+	}
+}
+
+static bool checkRandom(uint8_t setting, uint64_t samples, bool histogram)
+{
+	bool exact = delaySpecExact(setting);
+	uint64_t outOfRange = 0, cumulative = 0, pooled = 0;
+	uint32_t first = DELAYMC_MAX_SECONDS + 1, last = 0;
+	double sum = 0, mean = 0, chi2 = 0, pooledExpected = 0, worst = 0;
+	uint32_t dof = 0;
+	uint64_t i;
+	uint32_t s;
+	bool pass = true;
+
+	memset(hist, 0, sizeof(hist));
+	for (i = 0; i < samples; i++)
+	{
+		uint32_t d = delaySelectSeconds(setting, true);
+		if (d > DELAYMC_MAX_SECONDS)
+			d = DELAYMC_MAX_SECONDS + 1;
+		hist[d]++;
+		sum += d;
+	}
+
+	for (s = 0; s <= DELAYMC_MAX_SECONDS; s++)
+	{
+		double mass = expectedMass(setting, s);
+		double cdf = delaySpecSecondsCDF(setting, s);
+
+		if (mass <= 0)
+		{
+			// Anything the description gives no chance of is wrong
+			outOfRange += hist[s];
+			continue;
+		}
+		if (s < first)
+			first = s;
+		last = s;
+		mean += mass * s;
+
+		// Biggest gap between the observed and described CDFs, in units of
+		//  what sampling noise allows at that point
+		cumulative += hist[s];
+		double gap = fabs((double)cumulative / samples - cdf);
+		double tolerance = DELAYMC_SIGMAS * sqrt(cdf * (1.0 - cdf) / samples) + 1.0 / samples;
+		if (!exact)
+			tolerance += DELAYMC_PIECE_SLACK;
+		if (gap / tolerance > worst)
+			worst = gap / tolerance;
+
+		// Pool seconds too unlikely to count on their own
+		pooled += hist[s];
+		pooledExpected += mass * samples;
+		if (pooledExpected >= DELAYMC_CHI2_MIN)
+		{
+			chi2 += (pooled - pooledExpected) * (pooled - pooledExpected) / pooledExpected;
+			pooled = 0;
+			pooledExpected = 0;
+			dof++;
+		}
+	}
+	outOfRange += hist[DELAYMC_MAX_SECONDS + 1];
+	if (pooledExpected > 0)
+	{
+		chi2 += (pooled - pooledExpected) * (pooled - pooledExpected) / pooledExpected;
+		dof++;
+	}
+	if (dof)
+		dof--;
+
+	double chi2Limit = dof + DELAYMC_SIGMAS * sqrt(2.0 * dof);
+	if (outOfRange || worst > 1.0 || (exact && chi2 > chi2Limit))
+		pass = false;
+
+	// Share of draws on the no-delay spike.  Anything else the description
+	//  puts at DELAY_NONE_SECONDS counts toward the expected share too.
+	bool bimodal = hasNoDelay(setting);
+	double noDelay = (double)hist[DELAY_NONE_SECONDS] / samples;
+	double noDelaySpec = expectedMass(setting, DELAY_NONE_SECONDS);
+	if (bimodal && fabs(noDelay - noDelaySpec) > DELAYMC_SIGMAS * sqrt(noDelaySpec * (1.0 - noDelaySpec) / samples) + 0.5 / samples)
+		pass = false;
+
+	printf("%2u  random %3u-%-3us  mean %6.2f (spec %6.2f)  p5 %3u p25 %3u p50 %3u p75 %3u p95 %3u  ",
+		setting, first, last, sum / samples, mean,
+		percentile(samples, 0.05), percentile(samples, 0.25), percentile(samples, 0.50),
+		percentile(samples, 0.75), percentile(samples, 0.95));
+	if (bimodal)
+		printf("none %6.3f%% (spec %6.3f%%)", 100.0 * noDelay, 100.0 * noDelaySpec);
+	else
+		printf("none       -                ");
+	printf("  ks %4.2f  chi2 %7.1f/%-4u%s %s", worst, chi2, dof, exact ? "" : "*", pass ? "PASS" : "FAIL");
+	if (outOfRange)
+		printf("  (%llu out of range)", (unsigned long long)outOfRange);
+	putchar('\n');
+
+	if (histogram && first <= last)
+		printHistogram(setting, first, last, samples);
+
+	return pass;
+}
+
+static bool checkFixed(uint8_t setting)
+{
+	uint32_t d = delaySelectSeconds(setting, false);
+	bool pass = (d == setting * DELAY_SPEC_FIXED_STEP);
+
+	printf("%2u  fixed  %3us  %s\n", setting, d, pass ? "PASS" : "FAIL");
+	return pass;
+}
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [-n samples] [-s seed] [-d setting] [-p profiles] [-H]\n", name);
+	fprintf(stderr, "  -n samples   Samples per random setting (default 1000000)\n");
+	fprintf(stderr, "  -s seed      PRNG seed (default 1)\n");
+	fprintf(stderr, "  -d setting   Only check one delay DIP setting (0-15)\n");
+	fprintf(stderr, "  -p profiles  Profile description to check against (default %s)\n", DELAY_SPEC_FILE);
+	fprintf(stderr, "  -H           Print a histogram (and the expected share) for each random setting\n");
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t samples = 1000000;
+	unsigned int seed = 1;
+	int only = -1;
+	const char* profiles = DELAY_SPEC_FILE;
+	bool histogram = false;
+	bool pass = true;
+	int opt;
+	uint8_t setting;
+
+	while ((opt = getopt(argc, argv, "n:s:d:p:Hh")) != -1)
+	{
+		switch(opt)
+		{
+			case 'n':
+				samples = strtoull(optarg, NULL, 0);
+				break;
+			case 's':
+				seed = strtoul(optarg, NULL, 0);
+				break;
+			case 'd':
+				only = atoi(optarg);
+				break;
+			case 'p':
+				profiles = optarg;
+				break;
+			case 'H':
+				histogram = true;
+				break;
+			default:
+				usage(argv[0]);
+				return 2;
+		}
+	}
+
+	if (0 == samples || only >= DELAY_SPEC_SETTINGS)
+	{
+		usage(argv[0]);
+		return 2;
+	}
+
+	if (!delaySpecLoad(profiles))
+		return 2;
+
+	prngSeed(seed);
+
+	for (setting = 0; setting < DELAY_SPEC_SETTINGS; setting++)
+	{
+		if (only >= 0 && setting != only)
+			continue;
+		pass &= checkFixed(setting);
+	}
+
+	for (setting = 0; setting < DELAY_SPEC_SETTINGS; setting++)
+	{
+		if (only >= 0 && setting != only)
+			continue;
+		pass &= checkRandom(setting, samples, histogram);
+	}
+
+	printf("%s\n", pass ? "All delay profiles match the spec" : "Delay profiles DRIFTED from the spec");
+	return pass ? 0 : 1;
+}
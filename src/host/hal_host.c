@@ -0,0 +1,858 @@
+/*************************************************************************
+Title:    CKT-IIAB Hardware Abstraction Layer (Linux host)
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     host/hal_host.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+// The firmware's main() is renamed to firmwareMain() for the host build so
+// that this file can own the real entry point and parse the command line.
+#undef main
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "hal.h"
+#include "trace.h"
+#ifdef LINK_ENABLE
+#include "linkHub.h"
+#endif
+
+// The virtual clock runs in microseconds.  It only moves when the firmware
+// pets the watchdog or busy-waits, and the interrupt handlers are dispatched
+// from there - so time passes as fast as the host CPU can run the main loop.
+
+#define HOST_WDT_QUANTUM_US     20     // Main loop work credited per wdt_reset()
+#define HOST_ADC_CONVERSION_US  208    // 13 ADC clocks at 8MHz / 128
+#define HOST_EEPROM_WRITE_US    3400
+#define HOST_TIMER0_COUNT_US    (HAL_TIMER0_PRESCALER / (F_CPU / 1000000UL))
+
+#define HOST_FIXTURE_START_MS   3000   // Let the power-on lamp test finish
+#define HOST_FIXTURE_STUCK_MS   600000 // No green in 10 minutes means something is wrong
+
+extern int firmwareMain(void);
+extern uint16_t expressLatencyLast, expressLatencyMax, expressBudgetMisses;
+extern void ADC_vect(void);
+#ifndef INPUT_SHIFT_REGISTERS
+extern void PCINT_vect(void);
+#endif
+extern void TIMER0_COMPA_vect(void);
+#ifdef SIGNAL_PWM_BAM
+extern void TIMER0_COMPB_vect(void);
+#endif
+
+volatile uint8_t halHostSignalPort;
+#ifdef SIGNAL_OUTPUT_SHIFT_REGISTERS
+static uint8_t signalChain[SIGNAL_OUTPUT_SHIFT_REGISTERS];  // 74HC595 outputs, chip 0 first
+#endif
+volatile bool halHostInterruptsEnabled = false;
+
+static uint64_t virtualMicros = 0;
+
+// Timer0 compare matches, as virtual times
+static bool timer0Running = false;
+static uint64_t timer0MatchA = 0, timer0NextA = 0;
+static uint64_t timer0MatchB = 0, timer0NextB = UINT64_MAX;
+static bool timer0PendingA = false, timer0PendingB = false;
+static bool timer0IdleA = false;
+static uint64_t timer0ServicedA = 0;
+#ifdef SIGNAL_PWM_BAM
+static uint64_t timer0ServicedB = 0;
+#endif
+
+// Background ADC conversion, UINT64_MAX when idle
+static uint64_t adcDone = UINT64_MAX;
+static uint8_t adcChannel = 0;
+static bool adcPending = false;
+
+// Timer1 outputs, duty 0 meaning disconnected
+static uint8_t hardwarePWMDuty[2];
+
+static uint8_t detectorPins = 0x70;   // PB4 - PB6, active low with pull-ups
+static uint8_t detectorPinsSeen = 0x70;
+static bool detectorInterrupt = false;
+static uint8_t optionPins = 0x4F;     // PA0 - PA3 DIP (active low), PA6 common anode jumper
+static uint8_t adcOptions = 255;
+static uint8_t adcTimeout = 255;
+
+static bool verbose = false;
+
+// EEPROM starts erased, or loaded from (and saved back to) the -P file
+static uint8_t hostEeprom[HAL_EEPROM_SIZE];
+static const char* eepromFile = NULL;
+static uint64_t eepromBusyUntil = 0;
+static uint32_t eepromWrites = 0;
+static const char* traceFile = NULL;
+static const char* telemetryFile = NULL;
+static uint32_t hostEntropy = 1;  // Stands in for ADC noise, -e to change
+static bool commonAnode = true;
+
+// Option resistor ladder readings, indexed by (random << 1) | searchlight
+static const uint8_t optionLadder[4] = { 255, 180, 130, 64 };
+// Timeout resistor ladder readings, indexed by timeout setting
+static const uint8_t timeoutLadder[4] = { 255, 130, 180, 64 };
+
+// The fixture mirrors iiab-delay-test.ino: cover approach A, wait for green
+// on head A, then walk a train through the diamond and out the other side.
+// With -b it runs the same trains the other way, from approach B.
+typedef enum
+{
+	FIXTURE_WAIT_START,
+	FIXTURE_WAIT_GREEN,
+	FIXTURE_DIAMOND_ON,
+	FIXTURE_EXIT_ON,
+	FIXTURE_APPROACH_OFF,
+	FIXTURE_DIAMOND_OFF,
+	FIXTURE_EXIT_OFF,
+	FIXTURE_NEXT_TRAIN,
+} FixtureState;
+
+static FixtureState fixtureState = FIXTURE_WAIT_START;
+static uint64_t fixtureTime = (uint64_t)HOST_FIXTURE_START_MS * 1000;
+static uint64_t fixtureTrigger = 0;
+static uint32_t trainCount = 0;
+static uint32_t trainLimit = 1000;
+static uint64_t virtualLimit = 0;
+static struct timespec wallStart;
+
+#define FIXTURE_APPROACH_A  _BV(PB6)
+#define FIXTURE_DIAMOND     _BV(PB5)
+#define FIXTURE_APPROACH_B  _BV(PB4)
+
+static bool fixtureFromB = false;
+static uint8_t fixtureApproach = FIXTURE_APPROACH_A;
+static uint8_t fixtureExit = FIXTURE_APPROACH_B;
+
+static void eepromLoad(void)
+{
+	memset(hostEeprom, 0xFF, sizeof(hostEeprom));
+	if (!eepromFile)
+		return;
+
+	FILE* f = fopen(eepromFile, "rb");
+	if (f)
+	{
+		if (fread(hostEeprom, 1, sizeof(hostEeprom), f) != sizeof(hostEeprom))
+			fprintf(stderr, "%s: short EEPROM image, the rest is erased\n", eepromFile);
+		fclose(f);
+	}
+}
+
+static void eepromSave(void)
+{
+	if (!eepromFile)
+		return;
+
+	FILE* f = fopen(eepromFile, "wb");
+	if (!f || fwrite(hostEeprom, 1, sizeof(hostEeprom), f) != sizeof(hostEeprom) || fclose(f))
+		perror(eepromFile);
+}
+
+#ifdef TRACE_ENABLE
+static FILE* traceOut;
+
+static void tracePutFile(uint8_t data)
+{
+	fputc(data, traceOut);
+}
+
+// Same bytes traceInitialize() would have left in EEPROM after a reset
+static void traceSave(void)
+{
+	if (!traceFile)
+		return;
+
+	traceOut = fopen(traceFile, "wb");
+	if (!traceOut)
+	{
+		perror(traceFile);
+		return;
+	}
+	traceDump(tracePutFile);
+	if (fclose(traceOut))
+		perror(traceFile);
+}
+#endif
+
+#ifdef TELEMETRY_ENABLE
+
+// Telemetry bytes leave at the UART's pace, 11 bit times each, and go to the
+//  -m file as they finish.  Nothing runs the line in between, so the queue is
+//  only caught up whenever the firmware looks at it.
+#define HOST_TELEMETRY_BYTE_US  (11 * 1000000UL / HAL_UART_BAUD)
+
+static uint8_t telemetryQueue[HAL_TELEMETRY_BUFFER];
+static uint8_t telemetryHead = 0, telemetryCount = 0;
+static uint64_t telemetryByteDone = 0;
+static FILE* telemetryOut = NULL;
+
+static void telemetryDrain(bool all)
+{
+	while (telemetryCount && (all || virtualMicros >= telemetryByteDone))
+	{
+		uint8_t data = telemetryQueue[(uint8_t)(telemetryHead - telemetryCount) & (HAL_TELEMETRY_BUFFER - 1)];
+		if (telemetryOut)
+			fputc(data, telemetryOut);
+		telemetryCount--;
+		telemetryByteDone += HOST_TELEMETRY_BYTE_US;
+	}
+}
+
+void halTelemetryInitialize(void)
+{
+	if (!telemetryFile)
+		return;
+	telemetryOut = fopen(telemetryFile, "wb");
+	if (!telemetryOut)
+		perror(telemetryFile);
+}
+
+uint8_t halTelemetryTxFree(void)
+{
+	telemetryDrain(false);
+	return HAL_TELEMETRY_BUFFER - 1 - telemetryCount;
+}
+
+void halTelemetrySend(uint8_t data)
+{
+	telemetryDrain(false);
+	if (telemetryCount >= HAL_TELEMETRY_BUFFER - 1)
+		return;
+	if (0 == telemetryCount)
+		telemetryByteDone = virtualMicros + HOST_TELEMETRY_BYTE_US;
+	telemetryQueue[telemetryHead] = data;
+	telemetryHead = (telemetryHead + 1) & (HAL_TELEMETRY_BUFFER - 1);
+	telemetryCount++;
+}
+
+static void telemetrySave(void)
+{
+	telemetryDrain(true);
+	if (telemetryOut && fclose(telemetryOut))
+		perror(telemetryFile);
+	telemetryOut = NULL;
+}
+
+#endif
+
+static void fixtureFinish(int status)
+{
+	struct timespec wallEnd;
+	clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+	double wall = (wallEnd.tv_sec - wallStart.tv_sec) + (wallEnd.tv_nsec - wallStart.tv_nsec) / 1e9;
+	double virt = virtualMicros / 1e6;
+
+	fflush(stdout);
+	eepromSave();
+#ifdef TRACE_ENABLE
+	traceSave();
+#endif
+#ifdef TELEMETRY_ENABLE
+	telemetrySave();
+#endif
+	fprintf(stderr, "%u trains in %.1f virtual seconds (%.2f h), %.2f s wall, %.0fx real time\n",
+		trainCount, virt, virt / 3600.0, wall, (wall > 0) ? virt / wall : 0.0);
+	if (eepromWrites)
+		fprintf(stderr, "%u EEPROM writes\n", eepromWrites);
+	if (expressLatencyMax)
+		fprintf(stderr, "Express clear latency %u ms last, %u ms max, %u over budget\n",
+			expressLatencyLast, expressLatencyMax, expressBudgetMisses);
+	exit(status);
+}
+
+static bool fixtureGreen(bool headB)
+{
+	// Signal A green is PB1, B is PB3.  Common anode lamps light when the pin
+	//  is low.  When OC1A/OC1B has the pin, it spends part of every PWM cycle lit.
+	if (hardwarePWMDuty[headB ? HAL_HW_PWM_OC1B : HAL_HW_PWM_OC1A])
+		return true;
+
+#ifdef SIGNAL_OUTPUT_SHIFT_REGISTERS
+	// Through the shift registers they're QC and QF of the first chip
+	bool pinHigh = (signalChain[0] & (headB ? 0x20 : 0x04)) != 0;
+#else
+	bool pinHigh = (halHostSignalPort & _BV(headB ? PB3 : PB1)) != 0;
+#endif
+	return commonAnode ? !pinHigh : pinHigh;
+}
+
+static void fixtureStep(void)
+{
+	if (FIXTURE_WAIT_GREEN == fixtureState)
+	{
+		if (fixtureGreen(fixtureFromB))
+		{
+			printf("%u,%llu\n", trainCount, (unsigned long long)((virtualMicros - fixtureTrigger) / 1000));
+			trainCount++;
+			fixtureTime = virtualMicros + 250000;
+			fixtureState = FIXTURE_DIAMOND_ON;
+		}
+		else if (virtualMicros - fixtureTrigger > (uint64_t)HOST_FIXTURE_STUCK_MS * 1000)
+		{
+			fprintf(stderr, "Train %u: no green on head %c after %u ms\n", trainCount, fixtureFromB ? 'B' : 'A', HOST_FIXTURE_STUCK_MS);
+			fixtureFinish(1);
+		}
+		return;
+	}
+
+	if (virtualMicros < fixtureTime)
+		return;
+
+	switch(fixtureState)
+	{
+		case FIXTURE_WAIT_START:
+		case FIXTURE_NEXT_TRAIN:
+			if ((trainLimit && trainCount >= trainLimit) || (virtualLimit && virtualMicros >= virtualLimit))
+				fixtureFinish(0);
+			detectorPins &= ~fixtureApproach;  // Trigger approach
+			fixtureTrigger = virtualMicros;
+			fixtureState = FIXTURE_WAIT_GREEN;
+			return;
+		case FIXTURE_DIAMOND_ON:
+			detectorPins &= ~FIXTURE_DIAMOND;
+			fixtureState = FIXTURE_EXIT_ON;
+			break;
+		case FIXTURE_EXIT_ON:
+			detectorPins &= ~fixtureExit;
+			fixtureState = FIXTURE_APPROACH_OFF;
+			break;
+		case FIXTURE_APPROACH_OFF:
+			detectorPins |= fixtureApproach;
+			fixtureState = FIXTURE_DIAMOND_OFF;
+			break;
+		case FIXTURE_DIAMOND_OFF:
+			detectorPins |= FIXTURE_DIAMOND;
+			fixtureState = FIXTURE_EXIT_OFF;
+			break;
+		case FIXTURE_EXIT_OFF:
+			detectorPins |= fixtureExit;
+			fixtureState = FIXTURE_NEXT_TRAIN;
+			fixtureTime = virtualMicros + 500000;
+			return;
+		case FIXTURE_WAIT_GREEN:
+			break;
+	}
+	fixtureTime = virtualMicros + 250000;
+}
+
+#ifdef LINK_ENABLE
+
+// Link bytes queue here between hub ticks.  Without -L no port is connected
+//  and the board runs on its own.
+#define HOST_LINK_BUFFER  256
+
+typedef struct
+{
+	uint8_t data[HOST_LINK_BUFFER];
+	uint8_t head, tail;
+} HostLinkQueue_t;
+
+static HostLinkQueue_t linkTx[LINK_PORTS], linkRx[LINK_PORTS];
+static int linkHubFd = -1;
+static uint8_t linkPortsWired = 0;
+static uint8_t linkNode = 0;
+static uint64_t linkNextSync = UINT64_MAX;
+
+static bool linkQueuePop(HostLinkQueue_t* q, uint8_t* data)
+{
+	if (q->head == q->tail)
+		return false;
+	*data = q->data[q->tail++];
+	return true;
+}
+
+static void linkQueuePush(HostLinkQueue_t* q, uint8_t data)
+{
+	if ((uint8_t)(q->head + 1) != q->tail)
+		q->data[q->head++] = data;
+}
+
+static void linkHubTransfer(void* buffer, size_t length, bool send)
+{
+	uint8_t* p = buffer;
+
+	while (length)
+	{
+		ssize_t n = send ? write(linkHubFd, p, length) : read(linkHubFd, p, length);
+		if (n <= 0)
+			fixtureFinish(0);  // Hub's done with us
+		p += n;
+		length -= n;
+	}
+}
+
+// Lockstep with host/linkhub - report this tick, then wait for the next one
+static void linkHubSync(void)
+{
+	LinkHubBoard_t out;
+	LinkHubTick_t in;
+	uint8_t port, i;
+
+	memset(&out, 0, sizeof(out));
+	for (port = 0; port < LINK_PORTS; port++)
+		while (out.tx.count[port] < LINK_HUB_MAX_BYTES && linkQueuePop(&linkTx[port], &out.tx.data[port][out.tx.count[port]]))
+			out.tx.count[port]++;
+	out.greens = (fixtureGreen(false) ? LINK_HUB_GREEN_A : 0) | (fixtureGreen(true) ? LINK_HUB_GREEN_B : 0);
+
+	linkHubTransfer(&out, sizeof(out), true);
+	linkHubTransfer(&in, sizeof(in), false);
+
+	for (port = 0; port < LINK_PORTS; port++)
+		for (i = 0; i < in.rx.count[port] && i < LINK_HUB_MAX_BYTES; i++)
+			linkQueuePush(&linkRx[port], in.rx.data[port][i]);
+
+	linkNextSync += LINK_HUB_TICK_US;
+}
+
+void halLinkInitialize(void)
+{
+}
+
+uint8_t halLinkNode(void)
+{
+	return linkNode;
+}
+
+bool halLinkConnected(uint8_t port)
+{
+	return (linkPortsWired >> port) & 0x01;
+}
+
+uint8_t halLinkTxFree(uint8_t port)
+{
+	return HAL_LINK_BUFFER - 1 - (uint8_t)(linkTx[port].head - linkTx[port].tail);
+}
+
+void halLinkSend(uint8_t port, uint8_t data)
+{
+	linkQueuePush(&linkTx[port], data);
+}
+
+bool halLinkReceive(uint8_t port, uint8_t* data)
+{
+	return linkQueuePop(&linkRx[port], data);
+}
+
+#endif
+
+// Virtual time stands still inside the interrupt handlers, so they take no counts
+uint8_t halTimerCount(void)
+{
+	return 0;
+}
+
+#ifndef SIGNAL_PWM_BAM
+static uint64_t timer0PeriodA(void)
+{
+	if (timer0IdleA)
+		return (HAL_IDLE_TICK_COUNTS + 1) * 64 / (F_CPU / 1000000UL);
+	return (HAL_TICK_COUNTS + 1) * HOST_TIMER0_COUNT_US;
+}
+#endif
+
+static void dispatchInterrupts(void)
+{
+	if (!halHostInterruptsEnabled)
+		return;
+
+	// Lower vector numbers win, same as the AVR
+#ifndef INPUT_SHIFT_REGISTERS
+	if (detectorInterrupt && detectorPins != detectorPinsSeen)
+	{
+		detectorPinsSeen = detectorPins;
+		PCINT_vect();
+	}
+#endif
+	if (adcPending)
+	{
+		adcPending = false;
+		ADC_vect();
+	}
+	if (timer0PendingA)
+	{
+		timer0PendingA = false;
+		timer0ServicedA = timer0MatchA;
+		TIMER0_COMPA_vect();
+	}
+#ifdef SIGNAL_PWM_BAM
+	if (timer0PendingB)
+	{
+		timer0PendingB = false;
+		timer0ServicedB = timer0MatchB;
+		TIMER0_COMPB_vect();
+	}
+#endif
+}
+
+static void advance(uint64_t us)
+{
+	uint64_t target = virtualMicros + us;
+
+	for (;;)
+	{
+		uint64_t next = adcDone;
+		if (timer0Running && timer0NextA < next)
+			next = timer0NextA;
+		if (timer0Running && timer0NextB < next)
+			next = timer0NextB;
+#ifdef LINK_ENABLE
+		if (linkNextSync < next)
+			next = linkNextSync;
+#endif
+		if (next > target)
+			break;
+
+		virtualMicros = next;
+		if (adcDone == next)
+		{
+			adcDone = UINT64_MAX;
+			adcPending = true;
+		}
+		if (timer0Running && timer0NextA == next)
+		{
+			timer0MatchA = next;
+#ifdef SIGNAL_PWM_BAM
+			// Free running - unless the compare register moves, the next match is a full wrap away
+			timer0NextA = next + 256 * HOST_TIMER0_COUNT_US;
+			timer0PendingA = !timer0IdleA;
+#else
+			timer0NextA = next + timer0PeriodA();
+			timer0PendingA = true;
+#endif
+		}
+		if (timer0Running && timer0NextB == next)
+		{
+			timer0MatchB = next;
+			timer0NextB = next + 256 * HOST_TIMER0_COUNT_US;
+			timer0PendingB = true;
+		}
+#ifdef LINK_ENABLE
+		if (linkNextSync == next)
+			linkHubSync();
+#endif
+		dispatchInterrupts();
+		fixtureStep();
+	}
+
+	virtualMicros = target;
+	dispatchInterrupts();
+	fixtureStep();
+}
+
+void halHostWatchdogReset(void)
+{
+	advance(HOST_WDT_QUANTUM_US);
+}
+
+void halHostDelayUs(uint32_t us)
+{
+	advance(us);
+}
+
+void halInitialize(void)
+{
+	halHostSignalPort = 0;
+}
+
+uint8_t halResetCause(void)
+{
+	return HAL_RESET_POWER_ON;
+}
+
+void halInitializeTimer(void)
+{
+	timer0Running = true;
+#ifdef SIGNAL_PWM_BAM
+	timer0NextA = virtualMicros + 1 * HOST_TIMER0_COUNT_US;
+	timer0NextB = virtualMicros + HAL_TICK_COUNTS * HOST_TIMER0_COUNT_US;
+#else
+	timer0NextA = virtualMicros + timer0PeriodA();
+#endif
+}
+
+void halTimerPWMIdle(bool idle)
+{
+	timer0IdleA = idle;
+#ifdef SIGNAL_PWM_BAM
+	timer0PendingA = false;
+	timer0MatchA = virtualMicros;
+	if (!idle)
+		timer0NextA = virtualMicros + 2 * HOST_TIMER0_COUNT_US;
+#else
+	timer0NextA = virtualMicros + timer0PeriodA();
+#endif
+}
+
+void halTimerPWMAdvance(uint8_t counts)
+{
+	timer0NextA = timer0MatchA + (counts ? counts : 256) * HOST_TIMER0_COUNT_US;
+}
+
+void halTimerTickAdvance(void)
+{
+	timer0NextB = timer0MatchB + HAL_TICK_COUNTS * HOST_TIMER0_COUNT_US;
+}
+
+void halInitializeHardwarePWM(void)
+{
+	hardwarePWMDuty[HAL_HW_PWM_OC1A] = hardwarePWMDuty[HAL_HW_PWM_OC1B] = 0;
+}
+
+void halHardwarePWMSet(uint8_t channel, uint8_t duty, bool activeLow)
+{
+	hardwarePWMDuty[channel & 0x01] = duty;
+}
+
+void halSignalOutput(const uint8_t* frame)
+{
+#ifdef SIGNAL_OUTPUT_SHIFT_REGISTERS
+	memcpy(signalChain, frame, sizeof(signalChain));
+#else
+	halHostSignalPort = frame[0];
+#endif
+}
+
+void halInitializeADC(void)
+{
+}
+
+uint8_t halReadADC(uint8_t channel)
+{
+	advance(HOST_ADC_CONVERSION_US);
+	return (HAL_ADC_TIMEOUT == channel) ? adcTimeout : adcOptions;
+}
+
+void halStartADC(uint8_t channel)
+{
+	adcChannel = channel;
+	adcPending = false;
+	adcDone = virtualMicros + HOST_ADC_CONVERSION_US;
+}
+
+uint8_t halReadADCResult(void)
+{
+	return (HAL_ADC_TIMEOUT == adcChannel) ? adcTimeout : adcOptions;
+}
+
+uint32_t halEntropy(void)
+{
+	advance(32 * HOST_ADC_CONVERSION_US);
+	return hostEntropy;
+}
+
+uint8_t halReadOptionPins(void)
+{
+	return optionPins;
+}
+
+bool halReadCommonAnode(void)
+{
+	return 0 != (optionPins & _BV(PA6));
+}
+
+uint8_t halReadDetectorPins(void)
+{
+	return detectorPins;
+}
+
+#ifdef INPUT_SHIFT_REGISTERS
+// The fixture's three detectors are D0 - D2 of the first chip, in PB4 - PB6
+//  order, and everything else is clear
+uint32_t halReadShiftInputs(void)
+{
+	uint32_t data = (INPUT_SHIFT_REGISTERS < 4) ? ((1UL << (8 * INPUT_SHIFT_REGISTERS)) - 1) : 0xFFFFFFFFUL;
+	return (data & ~0x07UL) | ((detectorPins >> PB4) & 0x07);
+}
+#endif
+
+void halEnableDetectorInterrupt(void)
+{
+	detectorPinsSeen = detectorPins;
+	detectorInterrupt = true;
+}
+
+uint16_t halMicrosSinceTick(void)
+{
+#ifdef SIGNAL_PWM_BAM
+	return virtualMicros - timer0ServicedB;
+#else
+	return virtualMicros - timer0ServicedA;
+#endif
+}
+
+uint8_t halEepromRead(uint16_t address)
+{
+	if (halEepromBusy())
+		advance(eepromBusyUntil - virtualMicros);
+	return hostEeprom[address % HAL_EEPROM_SIZE];
+}
+
+void halEepromWrite(uint16_t address, uint8_t data)
+{
+	if (halEepromRead(address) != data)
+		halEepromWriteStart(address, data);
+}
+
+bool halEepromBusy(void)
+{
+	return virtualMicros < eepromBusyUntil;
+}
+
+void halEepromWriteStart(uint16_t address, uint8_t data)
+{
+	if (halEepromBusy())
+		fprintf(stderr, "%10.3f  EEPROM write started while busy\n", virtualMicros / 1e6);
+	hostEeprom[address % HAL_EEPROM_SIZE] = data;
+	eepromBusyUntil = virtualMicros + HOST_EEPROM_WRITE_US;
+	eepromWrites++;
+}
+
+void halStatusLedSend(struct cRGB* led)
+{
+	static uint64_t lastSend = 0;
+
+	if (lastSend && (virtualMicros - lastSend) < ws2812_resettime)
+		fprintf(stderr, "%10.3f  status LED resent after only %uus\n", virtualMicros / 1e6, (unsigned)(virtualMicros - lastSend));
+	lastSend = virtualMicros;
+
+	if (verbose)
+		fprintf(stderr, "%10.3f  status LED r=%u g=%u b=%u\n", virtualMicros / 1e6, led->r, led->g, led->b);
+}
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [-d delay] [-r] [-s] [-t timeout] [-c] [-b] [-n trains] [-H hours] [-S ms] [-e seed] [-v] [-P eeprom] [-T trace] [-m telemetry]\n", name);
+	fprintf(stderr, "  -d delay      DIP delay setting, 0-15 (default 0)\n");
+	fprintf(stderr, "  -r            Randomized delays\n");
+	fprintf(stderr, "  -s            Searchlight mode\n");
+	fprintf(stderr, "  -t timeout    Timeout setting, 0-3 (default 0)\n");
+	fprintf(stderr, "  -c            Common cathode signals (default common anode)\n");
+	fprintf(stderr, "  -b            Run the trains from approach B\n");
+	fprintf(stderr, "  -n trains     Stop after this many trains, 0 for no limit (default 1000)\n");
+	fprintf(stderr, "  -H hours      Stop after this much virtual time\n");
+	fprintf(stderr, "  -S ms         Extra idle time before the first train\n");
+	fprintf(stderr, "  -e seed       Value halEntropy() returns in place of ADC noise (default 1)\n");
+	fprintf(stderr, "  -v            Log status LED changes to stderr\n");
+	fprintf(stderr, "  -P eeprom     EEPROM image, loaded at start and saved at the end\n");
+	fprintf(stderr, "  -T trace      Save the event trace at the end, for host/tracedump (TRACE_ENABLE builds)\n");
+	fprintf(stderr, "  -m telemetry  Write the telemetry frames here, for host/teledump (TELEMETRY_ENABLE builds)\n");
+#ifdef LINK_ENABLE
+	fprintf(stderr, "  -N node       Link node number (default 0)\n");
+	fprintf(stderr, "  -L ports      Run under host/linkhub, with neighbours on these link ports (a, b or ab)\n");
+#endif
+	fprintf(stderr, "Prints index,millis for each train, like the delay test fixture.\n");
+}
+
+int main(int argc, char** argv)
+{
+	uint8_t delaySetting = 0, timeoutSetting = 0;
+	bool randomDelay = false, searchlight = false;
+	int opt;
+
+#ifdef LINK_ENABLE
+	const char* options = "d:rst:cbn:H:S:e:vP:T:m:N:L:h";
+#else
+	const char* options = "d:rst:cbn:H:S:e:vP:T:m:h";
+#endif
+
+	while ((opt = getopt(argc, argv, options)) != -1)
+	{
+		switch(opt)
+		{
+			case 'd':
+				delaySetting = atoi(optarg) & 0x0F;
+				break;
+			case 'r':
+				randomDelay = true;
+				break;
+			case 's':
+				searchlight = true;
+				break;
+			case 't':
+				timeoutSetting = atoi(optarg) & 0x03;
+				break;
+			case 'c':
+				commonAnode = false;
+				break;
+			case 'b':
+				fixtureFromB = true;
+				fixtureApproach = FIXTURE_APPROACH_B;
+				fixtureExit = FIXTURE_APPROACH_A;
+				break;
+			case 'n':
+				trainLimit = strtoul(optarg, NULL, 0);
+				break;
+			case 'H':
+				virtualLimit = (uint64_t)(atof(optarg) * 3600e6);
+				break;
+			case 'S':
+				fixtureTime += strtoull(optarg, NULL, 0) * 1000;
+				break;
+			case 'e':
+				hostEntropy = strtoul(optarg, NULL, 0);
+				break;
+			case 'v':
+				verbose = true;
+				break;
+			case 'P':
+				eepromFile = optarg;
+				break;
+			case 'T':
+#ifndef TRACE_ENABLE
+				fprintf(stderr, "-T needs a TRACE_ENABLE build\n");
+				return 2;
+#endif
+				traceFile = optarg;
+				break;
+			case 'm':
+#ifndef TELEMETRY_ENABLE
+				fprintf(stderr, "-m needs a TELEMETRY_ENABLE build\n");
+				return 2;
+#endif
+				telemetryFile = optarg;
+				break;
+#ifdef LINK_ENABLE
+			case 'N':
+				linkNode = atoi(optarg);
+				break;
+			case 'L':
+				linkHubFd = LINK_HUB_FD;
+				linkNextSync = LINK_HUB_TICK_US;
+				linkPortsWired = (strchr(optarg, 'a') ? _BV(LINK_PORT_A) : 0) | (strchr(optarg, 'b') ? _BV(LINK_PORT_B) : 0);
+				break;
+#endif
+			default:
+				usage(argv[0]);
+				return 2;
+		}
+	}
+
+	optionPins = (~delaySetting & 0x0F) | (commonAnode ? _BV(PA6) : 0);
+	adcOptions = optionLadder[(randomDelay ? 2 : 0) | (searchlight ? 1 : 0)];
+	adcTimeout = timeoutLadder[timeoutSetting];
+
+	eepromLoad();
+	clock_gettime(CLOCK_MONOTONIC, &wallStart);
+	return firmwareMain();
+}
@@ -0,0 +1,60 @@
+/*************************************************************************
+Title:    CKT-IIAB Link Hub Messages
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     host/linkHub.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _LINK_HUB_H_
+#define _LINK_HUB_H_
+
+#include <stdint.h>
+#include "link.h"
+
+// host/linkhub runs several LINK_ENABLE host builds in lockstep.  Each board
+//  stops its virtual clock every LINK_HUB_TICK_US, sends the hub whatever it
+//  transmitted since the last tick, and waits for the bytes that finished
+//  arriving from its neighbours.  The hub paces each wire at HAL_UART_BAUD.
+
+#define LINK_HUB_TICK_US    1000
+#define LINK_HUB_MAX_BYTES  16     // Per port per tick, far more than the wire carries
+#define LINK_HUB_FD         3      // Where a board finds its hub connection
+
+#define LINK_HUB_GREEN_A    0x01
+#define LINK_HUB_GREEN_B    0x02
+
+typedef struct
+{
+	uint8_t count[LINK_PORTS];
+	uint8_t data[LINK_PORTS][LINK_HUB_MAX_BYTES];
+} LinkHubBytes_t;
+
+// Board to hub, once per tick
+typedef struct
+{
+	LinkHubBytes_t tx;
+	uint8_t greens;    // LINK_HUB_GREEN_*, what the fixture sees on the heads
+} LinkHubBoard_t;
+
+// Hub to board, once per tick
+typedef struct
+{
+	LinkHubBytes_t rx;
+} LinkHubTick_t;
+
+#endif
@@ -0,0 +1,303 @@
+/*************************************************************************
+Title:    CKT-IIAB Link Hub
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     host/linkhub.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+// Runs a chain of LINK_ENABLE host builds ("make host OPTIONS=-DLINK_ENABLE")
+// in lockstep, wired together through their board-to-board links: board 0's
+// B side to board 1's A side, and so on.  Each wire carries bytes no faster
+// than HAL_UART_BAUD, and can be made to flip bits.
+//
+// Every board runs its own fixture (give odd ones -b to have trains heading
+// at each other).  The hub watches the heads on both sides of each shared
+// block, and complains if they are ever cleared into it at the same time.
+// Exits 1 if that happens, or if a board gives up.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "hal.h"
+#include "link.h"
+#include "linkHub.h"
+
+#define LINKHUB_MAX_BOARDS   8
+#define LINKHUB_WIRE_BUFFER  256
+#define LINKHUB_BYTE_US      (11 * 1000000UL / HAL_UART_BAUD)  // Start, 8 data, 2 stop
+#define LINKHUB_SETTLE_US    3000000   // Skip the power-on lamp test
+
+// One direction of one wire
+typedef struct
+{
+	uint8_t data[LINKHUB_WIRE_BUFFER];
+	uint64_t arrives[LINKHUB_WIRE_BUFFER];
+	uint8_t head, tail;
+	uint64_t busyUntil;
+	uint32_t bytes;
+	uint32_t flipped;
+} Wire_t;
+
+typedef struct
+{
+	pid_t pid;
+	int fd;
+	bool running;
+	uint8_t greens;
+	Wire_t wire[LINK_PORTS];   // Leaving through each port
+} Board_t;
+
+static Board_t boards[LINKHUB_MAX_BOARDS];
+static int boardCount;
+static uint32_t flipOneIn = 0;
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [-t seconds] [-x host] [-o prefix] [-E n] -- \"board 0 args\" \"board 1 args\" ...\n", name);
+	fprintf(stderr, "  -t seconds  Virtual time to run for (default 3600)\n");
+	fprintf(stderr, "  -x host     Host build to run (default ./ckt-iiab-host)\n");
+	fprintf(stderr, "  -o prefix   Save each board's train log as prefix<n>.log\n");
+	fprintf(stderr, "  -E n        Flip a bit in about one link byte in n\n");
+	fprintf(stderr, "Each board gets its own arguments (e.g. \"-n 0 -b\"), plus -N and -L from the hub.\n");
+}
+
+static void spawnBoard(int n, const char* host, const char* args, const char* prefix)
+{
+	Board_t* b = &boards[n];
+	char command[1024];
+	int sv[2];
+
+	snprintf(command, sizeof(command), "exec %s %s -N %d -L %s%s", host, args, n,
+		(n > 0) ? "a" : "", (n < boardCount - 1) ? "b" : "");
+
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv))
+	{
+		perror("socketpair");
+		exit(1);
+	}
+
+	b->pid = fork();
+	if (b->pid < 0)
+	{
+		perror("fork");
+		exit(1);
+	}
+	if (0 == b->pid)
+	{
+		char logName[256];
+		int out;
+
+		if (prefix)
+		{
+			snprintf(logName, sizeof(logName), "%s%d.log", prefix, n);
+			out = open(logName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		}
+		else
+			out = open("/dev/null", O_WRONLY);
+		if (out < 0 || dup2(out, STDOUT_FILENO) < 0 || dup2(sv[1], LINK_HUB_FD) < 0 || fcntl(LINK_HUB_FD, F_SETFD, 0) < 0)
+			_exit(1);
+		execl("/bin/sh", "sh", "-c", command, (char*)NULL);
+		_exit(1);
+	}
+
+	close(sv[1]);
+	b->fd = sv[0];
+	b->running = true;
+	fprintf(stderr, "Board %d: %s\n", n, command + 5);
+}
+
+static bool transfer(int fd, void* buffer, size_t length, bool send)
+{
+	uint8_t* p = buffer;
+
+	while (length)
+	{
+		ssize_t n = send ? write(fd, p, length) : read(fd, p, length);
+		if (n <= 0)
+			return false;
+		p += n;
+		length -= n;
+	}
+	return true;
+}
+
+static void wirePush(Wire_t* w, uint8_t data, uint64_t now)
+{
+	if ((uint8_t)(w->head + 1) == w->tail)
+		return;  // The board's own buffer would have stopped it long before this
+
+	if (flipOneIn && 0 == random() % flipOneIn)
+	{
+		data ^= 1 << (random() & 0x07);
+		w->flipped++;
+	}
+
+	w->busyUntil = ((w->busyUntil > now) ? w->busyUntil : now) + LINKHUB_BYTE_US;
+	w->data[w->head] = data;
+	w->arrives[w->head] = w->busyUntil;
+	w->head++;
+	w->bytes++;
+}
+
+// Which board and port is at the other end of a board's port
+static int neighbour(int n, uint8_t port, uint8_t* farPort)
+{
+	*farPort = (LINK_PORT_A == port) ? LINK_PORT_B : LINK_PORT_A;
+	n += (LINK_PORT_A == port) ? -1 : 1;
+	return (n >= 0 && n < boardCount) ? n : -1;
+}
+
+int main(int argc, char** argv)
+{
+	const char* host = "./ckt-iiab-host";
+	const char* prefix = NULL;
+	uint64_t ticks = 3600ULL * 1000000 / LINK_HUB_TICK_US;
+	uint64_t tick, conflictMs = 0;
+	bool failed = false;
+	int opt, n;
+
+	while ((opt = getopt(argc, argv, "t:x:o:E:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 't':
+				ticks = (uint64_t)(atof(optarg) * 1e6 / LINK_HUB_TICK_US);
+				break;
+			case 'x':
+				host = optarg;
+				break;
+			case 'o':
+				prefix = optarg;
+				break;
+			case 'E':
+				flipOneIn = strtoul(optarg, NULL, 0);
+				break;
+			default:
+				usage(argv[0]);
+				return 2;
+		}
+	}
+
+	boardCount = argc - optind;
+	if (boardCount < 2 || boardCount > LINKHUB_MAX_BOARDS)
+	{
+		usage(argv[0]);
+		return 2;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	for (n = 0; n < boardCount; n++)
+		spawnBoard(n, host, argv[optind + n], prefix);
+
+	for (tick = 1; tick <= ticks && !failed; tick++)
+	{
+		uint64_t now = tick * LINK_HUB_TICK_US;
+		uint8_t port;
+
+		// Everyone's reached this tick - collect what they sent
+		for (n = 0; n < boardCount; n++)
+		{
+			Board_t* b = &boards[n];
+			LinkHubBoard_t msg;
+			uint8_t i;
+
+			if (!transfer(b->fd, &msg, sizeof(msg), false))
+			{
+				fprintf(stderr, "Board %d stopped at %.3f s\n", n, now / 1e6);
+				b->running = false;
+				failed = true;
+				break;
+			}
+			b->greens = msg.greens;
+
+			for (port = 0; port < LINK_PORTS; port++)
+				for (i = 0; i < msg.tx.count[port] && i < LINK_HUB_MAX_BYTES; i++)
+					wirePush(&b->wire[port], msg.tx.data[port][i], now);
+		}
+		if (failed)
+			break;
+
+		// Heads facing each other across a shared block
+		for (n = 0; n < boardCount - 1 && now >= LINKHUB_SETTLE_US; n++)
+		{
+			if ((boards[n].greens & LINK_HUB_GREEN_A) && (boards[n + 1].greens & LINK_HUB_GREEN_B))
+			{
+				if (0 == conflictMs++)
+					fprintf(stderr, "%10.3f  boards %d and %d both cleared into the block between them\n", now / 1e6, n, n + 1);
+			}
+		}
+
+		// Hand over whatever has finished arriving
+		for (n = 0; n < boardCount; n++)
+		{
+			LinkHubTick_t msg;
+
+			memset(&msg, 0, sizeof(msg));
+			for (port = 0; port < LINK_PORTS; port++)
+			{
+				uint8_t farPort;
+				int far = neighbour(n, port, &farPort);
+				if (far < 0)
+					continue;
+
+				Wire_t* w = &boards[far].wire[farPort];
+				while (w->tail != w->head && w->arrives[w->tail] <= now && msg.rx.count[port] < LINK_HUB_MAX_BYTES)
+					msg.rx.data[port][msg.rx.count[port]++] = w->data[w->tail++];
+			}
+			if (!transfer(boards[n].fd, &msg, sizeof(msg), true))
+			{
+				fprintf(stderr, "Board %d stopped at %.3f s\n", n, now / 1e6);
+				boards[n].running = false;
+				failed = true;
+				break;
+			}
+		}
+	}
+
+	// Closing the connections ends the boards, which print their own summaries
+	for (n = 0; n < boardCount; n++)
+		close(boards[n].fd);
+	for (n = 0; n < boardCount; n++)
+	{
+		int status;
+		waitpid(boards[n].pid, &status, 0);
+		if (boards[n].running && !(WIFEXITED(status) && 0 == WEXITSTATUS(status)))
+			failed = true;
+	}
+
+	fprintf(stderr, "%.1f virtual seconds, %d boards\n", (tick - 1) * LINK_HUB_TICK_US / 1e6, boardCount);
+	for (n = 0; n < boardCount; n++)
+	{
+		fprintf(stderr, "Board %d: sent %u bytes A side, %u bytes B side",
+			n, boards[n].wire[LINK_PORT_A].bytes, boards[n].wire[LINK_PORT_B].bytes);
+		if (flipOneIn)
+			fprintf(stderr, ", %u corrupted", boards[n].wire[LINK_PORT_A].flipped + boards[n].wire[LINK_PORT_B].flipped);
+		fputc('\n', stderr);
+	}
+	if (conflictMs)
+		fprintf(stderr, "CONFLICT: opposing heads cleared into a shared block for %llu ms\n", (unsigned long long)conflictMs);
+
+	return (failed || conflictMs) ? 1 : 0;
+}
@@ -0,0 +1,168 @@
+/*************************************************************************
+Title:    CKT-IIAB EEPROM Event Log Decoder
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     host/logdump.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+// Prints the interlocking cycles in an EEPROM image's event log (see
+// eventLog.h), oldest first.  Read the image off a board with
+// avrdude -U eeprom:r:eeprom.bin:r, or use the host build's -P file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "hal.h"
+#include "eepromMap.h"
+#include "eventLog.h"
+
+static const char* const outcomeNames[] = { "cleared", "lockout", "timeout", "?" };
+
+static uint8_t eeprom[HAL_EEPROM_SIZE];
+
+static const uint8_t* block(uint8_t n)
+{
+	return eeprom + EEPROM_LOG_ADDR + (n % EEPROM_LOG_BLOCKS) * EEPROM_LOG_BLOCK_SIZE;
+}
+
+// Bytes used, or 0 if the varint runs off the end
+static uint8_t varintGet(const uint8_t* data, uint8_t length, uint32_t* value)
+{
+	uint8_t n = 0, shift = 0;
+
+	*value = 0;
+	while (n < length && shift < 35)
+	{
+		uint8_t b = data[n++];
+		*value |= (uint32_t)(b & 0x7F) << shift;
+		if (!(b & 0x80))
+			return n;
+		shift += 7;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t outcomes[4] = { 0, 0, 0, 0 };
+	uint32_t directions[2] = { 0, 0 };
+	uint32_t records = 0, torn = 0, sessionSeconds = 0;
+	bool sessionKnown = false;
+	uint8_t newest, n;
+	FILE* f;
+
+	if (argc != 2)
+	{
+		fprintf(stderr, "Usage: %s eeprom.bin\n", argv[0]);
+		return 2;
+	}
+
+	f = fopen(argv[1], "rb");
+	if (!f)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+	if (fread(eeprom, 1, sizeof(eeprom), f) != sizeof(eeprom))
+	{
+		fprintf(stderr, "%s: not a %u byte EEPROM image\n", argv[1], HAL_EEPROM_SIZE);
+		fclose(f);
+		return 1;
+	}
+	fclose(f);
+
+	// Same search as eventLogInitialize()
+	newest = EEPROM_LOG_BLOCKS - 1;
+	for (n = 0; n < EEPROM_LOG_BLOCKS; n++)
+	{
+		if (block(n + 1)[0] != (uint8_t)(block(n)[0] + 1))
+		{
+			newest = n;
+			break;
+		}
+	}
+
+	printf("    power up    dir  delay  clear  occupied  outcome\n");
+	for (n = 1; n <= EEPROM_LOG_BLOCKS; n++)
+	{
+		const uint8_t* b = block(newest + n);
+		uint8_t offset = 1;
+
+		while (offset < EEPROM_LOG_BLOCK_SIZE && EVENT_LOG_END != b[offset])
+		{
+			uint8_t header = b[offset];
+			uint32_t field[4];
+			uint8_t i, used = 1;
+
+			for (i = 0; i < 4; i++)
+			{
+				if (2 == i && (header & EVENT_LOG_UNCLEARED))
+				{
+					field[i] = 0;
+					continue;
+				}
+				uint8_t length = varintGet(b + offset + used, EEPROM_LOG_BLOCK_SIZE - offset - used, &field[i]);
+				if (0 == length)
+					break;
+				used += length;
+			}
+			if (i < 4)
+			{
+				torn++;
+				break;
+			}
+			offset += used;
+			if (!(header & EVENT_LOG_UNCLEARED))
+				field[2] += field[1];  // Stored as the wait after the delay
+
+			if (header & EVENT_LOG_BOOT)
+			{
+				if (records)
+					printf("    -- power cycle --\n");
+				sessionSeconds = field[0];
+				sessionKnown = true;
+			}
+			else
+				sessionSeconds += field[0];
+
+			uint8_t outcome = (header & EVENT_LOG_OUTCOME_MASK) >> EVENT_LOG_OUTCOME_SHIFT;
+			char when[16];
+			if (sessionKnown)
+				snprintf(when, sizeof(when), "%9us", sessionSeconds);
+			else
+				snprintf(when, sizeof(when), "%+9ds", (int)sessionSeconds);
+
+			printf("  %s    %c  %4us%s  %4us  %7us   %s\n", when, (header & EVENT_LOG_DIRECTION_B) ? 'B' : 'A',
+				field[1], (header & EVENT_LOG_EXPRESS) ? "x" : (header & EVENT_LOG_RANDOM) ? "r" : " ",
+				field[2], field[3], outcomeNames[outcome]);
+
+			outcomes[outcome]++;
+			directions[(header & EVENT_LOG_DIRECTION_B) ? 1 : 0]++;
+			records++;
+		}
+	}
+
+	printf("%u cycles, %u from A and %u from B: %u cleared, %u locked out, %u timed out",
+		records, directions[0], directions[1], outcomes[EVENT_OUTCOME_CLEARED],
+		outcomes[EVENT_OUTCOME_LOCKOUT], outcomes[EVENT_OUTCOME_TIMEOUT]);
+	if (torn)
+		printf(", %u torn records", torn);
+	printf("\n(delay r = random, x = express; times before the oldest power up are relative to it)\n");
+	return 0;
+}
@@ -0,0 +1,133 @@
+/*************************************************************************
+Title:    CKT-IIAB Statistics Decoder
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     host/statsdump.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+// Prints the operating statistics in an EEPROM image (see stats.h).  Read
+// the image off a board with avrdude -U eeprom:r:eeprom.bin:r, or use the
+// host build's -P file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "hal.h"
+#include "eepromMap.h"
+#include "crc8.h"
+#include "stats.h"
+
+static const char* const resetNames[STATS_RESET_CAUSES] = { "power on", "external", "brown-out", "watchdog" };
+static const uint16_t delayBucketMax[STATS_DELAY_BUCKETS - 1] = STATS_DELAY_BUCKET_MAX;
+
+static uint8_t eeprom[HAL_EEPROM_SIZE];
+
+static void counter(const char* name, uint16_t value)
+{
+	if (0xFFFF == value)
+		printf("  %-28s 65535+\n", name);
+	else
+		printf("  %-28s %u\n", name, value);
+}
+
+int main(int argc, char** argv)
+{
+	Stats_t stats;
+	char name[32];
+	uint8_t i;
+	FILE* f;
+
+	if (argc != 2)
+	{
+		fprintf(stderr, "Usage: %s eeprom.bin\n", argv[0]);
+		return 2;
+	}
+
+	f = fopen(argv[1], "rb");
+	if (!f)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+	if (fread(eeprom, 1, sizeof(eeprom), f) != sizeof(eeprom))
+	{
+		fprintf(stderr, "%s: not a %u byte EEPROM image\n", argv[1], HAL_EEPROM_SIZE);
+		fclose(f);
+		return 1;
+	}
+	fclose(f);
+
+	// Both ends are little endian, and the layout has no padding before crc
+	memset(&stats, 0, sizeof(stats));
+	memcpy(&stats, eeprom + EEPROM_STATS_ADDR, STATS_BYTES);
+	if (STATS_VERSION != stats.version)
+	{
+		fprintf(stderr, "%s: no statistics (version %u, expected %u)\n", argv[1], stats.version, STATS_VERSION);
+		return 1;
+	}
+	if (crc8(eeprom + EEPROM_STATS_ADDR, STATS_BYTES - 1) != stats.crc)
+	{
+		fprintf(stderr, "%s: statistics CRC is bad - torn snapshot?\n", argv[1]);
+		return 1;
+	}
+
+	printf("Trains\n");
+	counter("from approach A", stats.trains[0]);
+	counter("from approach B", stats.trains[1]);
+	counter("timed out (STATE_TIMEOUT)", stats.timeouts);
+	counter("cleared through (CLEARING)", stats.clearings);
+	printf("  %-28s %u.%03us\n", "longest wait for the lock", stats.requestWaitMaxMs / 1000, stats.requestWaitMaxMs % 1000);
+
+	printf("Trains by delay DIP setting\n");
+	for (i = 0; i < STATS_DELAY_SETTINGS; i++)
+	{
+		if (!stats.delaySettingTrains[i])
+			continue;
+		snprintf(name, sizeof(name), "setting %u", i);
+		counter(name, stats.delaySettingTrains[i]);
+	}
+
+	if (STATS_DELAY_NONE == stats.delayBucketsSetting)
+		printf("Delays picked (no trains yet)\n");
+	else
+		printf("Delays picked since changing to %s delay setting %u\n",
+			(stats.delayBucketsSetting & STATS_DELAY_RANDOM) ? "random" : "fixed",
+			stats.delayBucketsSetting & (STATS_DELAY_SETTINGS - 1));
+	for (i = 0; i < STATS_DELAY_BUCKETS; i++)
+	{
+		if (0 == i)
+			snprintf(name, sizeof(name), "0-%us", delayBucketMax[0]);
+		else if (i < STATS_DELAY_BUCKETS - 1)
+			snprintf(name, sizeof(name), "%u-%us", delayBucketMax[i - 1] + 1, delayBucketMax[i]);
+		else
+			snprintf(name, sizeof(name), "over %us", delayBucketMax[i - 1]);
+		counter(name, stats.delayBuckets[i]);
+	}
+
+	printf("Resets\n");
+	for (i = 0; i < STATS_RESET_CAUSES; i++)
+		counter(resetNames[i], stats.resets[i]);
+	printf("  %-28s", "last one");
+	for (i = 0; i < STATS_RESET_CAUSES; i++)
+		if (stats.resetCause & (1 << i))
+			printf(" %s", resetNames[i]);
+	printf("%s\n", stats.resetCause ? "" : " unknown");
+	return 0;
+}
@@ -0,0 +1,130 @@
+/*************************************************************************
+Title:    CKT-IIAB Telemetry Decoder
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     host/teledump.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+// Prints the frames from a TELEMETRY_ENABLE build (see telemetry.h), one
+// line each, from a capture file, the host build's -m option, or a serial
+// port set to 2400 8N1 (stty -F /dev/ttyUSB0 2400 raw; host/teledump
+// /dev/ttyUSB0).  Bytes that don't make a frame with a good CRC are skipped
+// until the next sync byte.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "hal.h"
+#include "crc8.h"
+#include "telemetry.h"
+
+// InterlockState lives in ckt-iiab.c, so its names are repeated here
+static const char* const stateNames[] =
+{
+	"DELAY", "IDLE", "REQUEST", "CLEARANCE", "TIMEOUT", "OCCUPIED", "LOCKOUT", "CLEARING", "RESET",
+};
+static const char* const directionNames[] = { "A", "B", "diamond", "-" };
+
+static const char* lookup(const char* const* names, unsigned int count, unsigned int index)
+{
+	return (index < count) ? names[index] : "?";
+}
+
+static uint16_t get16(const uint8_t* p)
+{
+	return p[0] | ((uint16_t)p[1] << 8);
+}
+
+static void describe(const uint8_t* f)
+{
+	uint8_t options = f[5];
+
+	printf("%3u  %-9s %-7s  occ %c%c%c  dip %2u %c%c%c%c t%u  delay %5.1f timeout %5.1f lockout %5.1f  loop %5u/s  isr %5u/s %5.1f%%\n",
+		f[1], lookup(stateNames, 9, f[2] & 0x0F), lookup(directionNames, 4, f[2] >> 4),
+		(f[3] & 0x01) ? 'A' : '.', (f[3] & 0x04) ? 'D' : '.', (f[3] & 0x02) ? 'B' : '.',
+		f[4],
+		(options & TELEMETRY_OPT_RANDOM) ? 'R' : '-', (options & TELEMETRY_OPT_SEARCHLIGHT) ? 'S' : '-',
+		(options & TELEMETRY_OPT_COMMON_ANODE) ? 'A' : 'K', (options & TELEMETRY_OPT_EXPRESS) ? 'X' : '-',
+		(options >> TELEMETRY_OPT_TIMEOUT_SHIFT) & 0x03,
+		get16(f + 6) / 10.0, get16(f + 8) / 10.0, get16(f + 10) / 10.0,
+		get16(f + 12), get16(f + 14), get16(f + 16) / 10.0);
+}
+
+int main(int argc, char** argv)
+{
+	uint8_t frame[TELEMETRY_FRAME_BYTES];
+	unsigned int have = 0;
+	unsigned long frames = 0, bad = 0, skipped = 0, lost = 0;
+	int lastSeq = -1;
+	FILE* in = stdin;
+	int c;
+
+	if (argc > 2 || (argc == 2 && 0 == strcmp(argv[1], "-h")))
+	{
+		fprintf(stderr, "Usage: %s [file]\n", argv[0]);
+		fprintf(stderr, "Reads standard input without a file.  Columns: sequence, state, direction,\n");
+		fprintf(stderr, " occupancy (A diamond B), DIP, options (Random Searchlight Anode/cathode eXpress,\n");
+		fprintf(stderr, " timeout setting), seconds left on each timer, main loop and Timer0 interrupt rates\n");
+		fprintf(stderr, " and the share of the CPU the interrupts take.\n");
+		return 2;
+	}
+	if (argc == 2 && strcmp(argv[1], "-"))
+	{
+		in = fopen(argv[1], "rb");
+		if (!in)
+		{
+			perror(argv[1]);
+			return 1;
+		}
+	}
+
+	while ((c = fgetc(in)) != EOF)
+	{
+		if (0 == have && TELEMETRY_SYNC != c)
+		{
+			skipped++;
+			continue;
+		}
+		frame[have++] = c;
+		if (have < TELEMETRY_FRAME_BYTES)
+			continue;
+
+		if (crc8(frame, TELEMETRY_FRAME_BYTES - 1) != frame[TELEMETRY_FRAME_BYTES - 1])
+		{
+			// Resync from the next sync byte after this one
+			uint8_t* next = memchr(frame + 1, TELEMETRY_SYNC, TELEMETRY_FRAME_BYTES - 1);
+			bad++;
+			have = next ? TELEMETRY_FRAME_BYTES - (next - frame) : 0;
+			memmove(frame, next ? next : frame, have);
+			continue;
+		}
+
+		if (lastSeq >= 0)
+			lost += (uint8_t)(frame[1] - lastSeq - 1);
+		lastSeq = frame[1];
+		describe(frame);
+		frames++;
+		have = 0;
+		fflush(stdout);
+	}
+
+	fprintf(stderr, "%lu frames, %lu missed, %lu bad CRC, %lu stray bytes\n", frames, lost, bad, skipped);
+	return 0;
+}
@@ -0,0 +1,166 @@
+/*************************************************************************
+Title:    CKT-IIAB Event Trace Decoder
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     host/tracedump.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+// Prints the timeline in a TRACE_ENABLE trace dump (see trace.h), either
+// from a whole EEPROM image read back with avrdude (-U eeprom:r:file:r), or
+// saved by the host build's -T option.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "hal.h"
+#include "trace.h"
+#include "signalAspect.h"
+
+#define TRACEDUMP_MAX_RECORDS  256
+
+// InterlockState lives in ckt-iiab.c, so its names are repeated here
+static const char* const stateNames[] =
+{
+	"DELAY", "IDLE", "REQUEST", "CLEARANCE", "TIMEOUT", "OCCUPIED", "LOCKOUT", "CLEARING", "RESET",
+};
+static const char* const directionNames[] = { "approach A", "approach B", "diamond", "no direction" };
+static const char* const aspectNames[] =
+{
+	[ASPECT_OFF] = "off", [ASPECT_GREEN] = "green", [ASPECT_YELLOW] = "yellow",
+	[ASPECT_FL_YELLOW] = "flashing yellow", [ASPECT_RED] = "red", [ASPECT_FL_GREEN] = "flashing green",
+	[ASPECT_FL_RED] = "flashing red", [ASPECT_LUNAR] = "lunar",
+};
+static const char* const timerNames[] = { "delay", "timeout", "lockout" };
+
+typedef struct
+{
+	uint32_t delta;
+	uint8_t event;
+	uint8_t payload;
+} Event_t;
+
+static const char* lookup(const char* const* names, unsigned int count, unsigned int index)
+{
+	return (index < count && names[index]) ? names[index] : "?";
+}
+
+static void describe(const Event_t* e)
+{
+	switch(e->event)
+	{
+		case TRACE_BOOT:
+			printf("BOOT");
+			break;
+		case TRACE_STATE:
+			printf("STATE   %s, %s", lookup(stateNames, 9, e->payload & 0x0F), lookup(directionNames, 4, e->payload >> 4));
+			break;
+		case TRACE_INPUT:
+			printf("INPUT   approach A %s, diamond %s, approach B %s",
+				(e->payload & 0x01) ? "occupied" : "clear", (e->payload & 0x04) ? "occupied" : "clear",
+				(e->payload & 0x02) ? "occupied" : "clear");
+			break;
+		case TRACE_ASPECT:
+			printf("ASPECT  A %s, B %s", lookup(aspectNames, 8, e->payload >> 4), lookup(aspectNames, 8, e->payload & 0x0F));
+			break;
+		case TRACE_TIMER:
+			printf("TIMER   %s expired", lookup(timerNames, 3, e->payload));
+			break;
+		default:
+			printf("event %u, payload 0x%02X", e->event, e->payload);
+			break;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	static uint8_t buffer[HAL_EEPROM_SIZE + 1];
+	Event_t events[TRACEDUMP_MAX_RECORDS];
+	uint32_t gap = 0, newest, t;
+	const uint8_t* dump;
+	size_t length;
+	int count = 0, i;
+	FILE* f;
+
+	if (argc != 2)
+	{
+		fprintf(stderr, "Usage: %s dump\n", argv[0]);
+		fprintf(stderr, "  dump  EEPROM image (%u bytes) or a host -T trace file\n", HAL_EEPROM_SIZE);
+		return 2;
+	}
+
+	f = fopen(argv[1], "rb");
+	if (!f)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+	length = fread(buffer, 1, sizeof(buffer), f);
+	fclose(f);
+
+	dump = buffer;
+	if (HAL_EEPROM_SIZE == length)
+	{
+		dump += TRACE_EEPROM_ADDR;
+		length = TRACE_DUMP_BYTES;
+	}
+
+	if (length < TRACE_DUMP_HEADER || TRACE_DUMP_ID != dump[0] || dump[2] > dump[1]
+		|| length < TRACE_DUMP_HEADER + 3u * dump[2])
+	{
+		fprintf(stderr, "%s: no trace dump in it\n", argv[1]);
+		return 1;
+	}
+
+	newest = dump[4] | (dump[5] << 8) | ((uint32_t)dump[6] << 16) | ((uint32_t)dump[7] << 24);
+
+	// Fold the gap records into the delta of the event after them
+	for (i = 0; i < dump[2]; i++)
+	{
+		const uint8_t* r = dump + TRACE_DUMP_HEADER + 3 * i;
+
+		if (TRACE_GAP == r[1])
+		{
+			gap = ((uint32_t)r[2] << 16) | ((uint32_t)r[0] << 8);
+			continue;
+		}
+		events[count].delta = gap + r[0];
+		events[count].event = r[1];
+		events[count].payload = r[2];
+		count++;
+		gap = 0;
+	}
+
+	printf("%d events, the last %.3f s after boot\n", count, newest / 1000.0);
+
+	// Work back from the newest to find when each one happened
+	t = newest;
+	for (i = count - 1; i > 0; i--)
+		t -= events[i].delta;
+
+	for (i = 0; i < count; i++)
+	{
+		if (i)
+			t += events[i].delta;
+		printf("%10.3f s  %+9.3f  ", t / 1000.0, events[i].delta / 1000.0);
+		describe(&events[i]);
+		putchar('\n');
+	}
+	return 0;
+}
@@ -0,0 +1,20 @@
+/*************************************************************************
+Title:    Host stand-in for <util/atomic.h>
+File:     host/util/atomic.h
+License:  GNU General Public License v3
+
+    Interrupt handlers only run when the host HAL advances the virtual
+    clock, never in the middle of a block, so an atomic block is just a block.
+
+*************************************************************************/
+
+#ifndef _HOST_UTIL_ATOMIC_H_
+#define _HOST_UTIL_ATOMIC_H_
+
+#include <stdint.h>
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type)  for(uint8_t __atomicOnce = 1; __atomicOnce; __atomicOnce = 0)
+
+#endif
@@ -0,0 +1,20 @@
+/*************************************************************************
+Title:    Host stand-in for <util/delay.h>
+File:     host/util/delay.h
+License:  GNU General Public License v3
+
+    Busy-wait delays advance the virtual clock instead of burning time.
+
+*************************************************************************/
+
+#ifndef _HOST_UTIL_DELAY_H_
+#define _HOST_UTIL_DELAY_H_
+
+#include <stdint.h>
+
+void halHostDelayUs(uint32_t us);
+
+#define _delay_ms(ms)  halHostDelayUs((uint32_t)((ms) * 1000UL))
+#define _delay_us(us)  halHostDelayUs((uint32_t)(us))
+
+#endif
@@ -1,25 +1,87 @@
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "interlocking.h"
 #include "io.h"
+#ifdef LINK_ENABLE
+#include "link.h"
+#endif
 
-uint8_t interlockingStatus;
+// This board's routes, in InterlockingRoute order.  The two moves across the
+//  diamond need it clear and exclude each other.
+static const InterlockingRoute_t interlockingRoutes[NUM_ROUTES] PROGMEM =
+{
+	{ APPROACH_A, _BV(DIAMOND), _BV(ROUTE_APPROACH_A) | _BV(ROUTE_APPROACH_B) },
+	{ APPROACH_B, _BV(DIAMOND), _BV(ROUTE_APPROACH_A) | _BV(ROUTE_APPROACH_B) },
+};
 
-bool requestInterlocking(uint8_t direction)
+uint8_t interlockingGranted;
+
+bool requestRoute(uint8_t route)
 {
-	if(interlockingStatus & INTERLOCKING_LOCKED)
-		return false;  // Already locked
-	else if(interlockingBlockOccupancy())
-		return false;  // Interlocking occupied
-	
+	if(route >= NUM_ROUTES)
+		return false;
+
+	uint8_t blocks = pgm_read_byte(&interlockingRoutes[route].blocks);
+	uint8_t conflicts = pgm_read_byte(&interlockingRoutes[route].conflicts);
+
+	if((interlockingGranted & conflicts) || (blockOccupancy() & blocks))
+		return false;  // Conflicting route already granted, or a block it needs is occupied
+
+#ifdef LINK_ENABLE
+	if(!linkRouteClear(route))
+		return false;  // Neighbouring board hasn't agreed to it yet
+#endif
+
 	// Everything good.  Take it.
-	interlockingStatus = INTERLOCKING_LOCKED | _BV(direction);
+	interlockingGranted |= _BV(route);
 	return true;
 }
 
+void releaseRoute(uint8_t route)
+{
+	if(route < NUM_ROUTES)
+	{
+		interlockingGranted &= ~_BV(route);
+#ifdef LINK_ENABLE
+		linkRouteWithdraw(_BV(route));
+#endif
+	}
+}
+
+uint8_t grantedRoutes(void)
+{
+	return interlockingGranted;
+}
+
+uint8_t routeForApproach(uint8_t approach)
+{
+	uint8_t route;
+
+	for(route = 0; route < NUM_ROUTES; route++)
+	{
+		if(approach == pgm_read_byte(&interlockingRoutes[route].approach))
+			break;
+	}
+	return route;  // NUM_ROUTES if there isn't one
+}
+
+bool requestInterlocking(uint8_t direction)
+{
+	return requestRoute(routeForApproach(direction));
+}
+
+void releaseInterlocking(uint8_t direction)
+{
+	releaseRoute(routeForApproach(direction));
+}
 
+// Drops every route, for power up
 void clearInterlocking(void)
 {
-	interlockingStatus = 0;
+	interlockingGranted = 0;
+#ifdef LINK_ENABLE
+	linkRouteWithdraw(0xFF);
+#endif
 }
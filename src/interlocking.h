@@ -1,11 +1,40 @@
 #ifndef _INTERLOCKING_H_
 #define _INTERLOCKING_H_
 
+#include <stdint.h>
 #include <stdbool.h>
 
-#define INTERLOCKING_LOCKED 0x80
+// Route table interlocking
+// Each route is entered from one approach block, needs a set of blocks to be
+//  clear, and conflicts with a set of routes (including itself).  Blocks and
+//  routes are both bitmasks, so granting a route is a single test of the
+//  routes already granted and the current occupancy.  Routes that don't
+//  conflict can be held together, and each is released on its own.  The
+//  granted bitmask is also what the link (link.h) shares with the
+//  neighbouring boards.  Up to 8 routes.
 
+typedef enum
+{
+	ROUTE_APPROACH_A = 0,   // Approach A across the diamond
+	ROUTE_APPROACH_B,       // Approach B across the diamond
+	NUM_ROUTES
+} InterlockingRoute;
+
+typedef struct
+{
+	uint8_t approach;    // Block (io.h) the route is requested from
+	uint8_t blocks;      // _BV(Block) that must be clear to grant it
+	uint8_t conflicts;   // _BV(InterlockingRoute) that can't be granted alongside it
+} InterlockingRoute_t;
+
+bool requestRoute(uint8_t route);
+void releaseRoute(uint8_t route);
+uint8_t grantedRoutes(void);
+uint8_t routeForApproach(uint8_t approach);
+
+// Approach interface, used by the main state machine
 bool requestInterlocking(uint8_t direction);
+void releaseInterlocking(uint8_t direction);
 void clearInterlocking(void);
 
 #endif
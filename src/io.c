@@ -2,12 +2,14 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <avr/wdt.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include "hal.h"
 #include "io.h"
 #include "debouncer.h"
-#include "light_ws2812.h"
 #include "signalHead.h"
+#include "trace.h"
 
-DebounceState8_t inputDebouncer;
 DebounceState8_t dipDebouncer;
 
 extern volatile uint8_t signalHeadOptions;
@@ -17,17 +19,57 @@ bool searchlight;
 uint8_t delaySetting;
 uint8_t timeoutSetting;
 
+// Latest option ladder readings, refreshed in the background by the ADC
+//  interrupt so readDipSwitches() never has to wait on the converter
+static volatile uint8_t adcOptionsSample;
+static volatile uint8_t adcTimeoutSample;
+static volatile uint8_t adcSampleChannel;
+static volatile bool adcSampling = false;
+
+ISR(ADC_vect)
+{
+	uint8_t adcVal = halReadADCResult();
+
+	if (HAL_ADC_OPTIONS == adcSampleChannel)
+	{
+		// Chain straight into the timeout ladder
+		adcOptionsSample = adcVal;
+		adcSampleChannel = HAL_ADC_TIMEOUT;
+		halStartADC(HAL_ADC_TIMEOUT);
+	}
+	else
+	{
+		adcTimeoutSample = adcVal;
+		adcSampling = false;
+	}
+}
+
+static void startOptionSampling(void)
+{
+	if (adcSampling)
+		return;
+
+	adcSampling = true;
+	adcSampleChannel = HAL_ADC_OPTIONS;
+	halStartADC(HAL_ADC_OPTIONS);
+}
+
 void initializeInputOutput()
 {
-	ADMUX  = 0b00100011;  // VCC reference voltage; left-adjust; ADC3 (PA4)
-	ADCSRA = 0b10000111;  // ADC enabled; Manual trigger; 1/128 prescaler
-	ADCSRB = 0b00000000;  // Unipolar; 1x gain; Free running mode
-	DIDR0 |= _BV(ADC3D) | _BV(ADC4D);  // Disable ADC3 (PA4) and ADC4 (PA5) digital input buffer
+	halInitializeADC();
+
+	// Interrupts are still off, so take the first readings the slow way
+	wdt_reset();
+	adcOptionsSample = halReadADC(HAL_ADC_OPTIONS);
+	wdt_reset();
+	adcTimeoutSample = halReadADC(HAL_ADC_TIMEOUT);
+
+	initializeDetectors();
 }
 
 bool isCommonAnode(void)
 {
-	return ((PINA & _BV(PA6)) == _BV(PA6));
+	return halReadCommonAnode();
 }
 
 void readDipSwitches()
@@ -48,15 +90,10 @@ void readDipSwitches()
 	{
 		lastRead = millisTemp;
 
-		delaySetting_tmp = ~PINA & 0x0F;
+		delaySetting_tmp = ~halReadOptionPins() & 0x0F;
 		
-		// Read ADC for random, searchlight
-		wdt_reset();
-		ADMUX &= ~(_BV(MUX2)); //  ADC3 (PA4)
-		ADMUX |= _BV(MUX1) | _BV(MUX0);
-		ADCSRA |= _BV(ADSC);  // Start the conversion
-		while(ADCSRA & _BV(ADSC));  // Wait for conversion to complete; no WD reset in case it takes too long
-		adcVal = ADCH;
+		// Random, searchlight from the last background ADC sample
+		adcVal = adcOptionsSample;
 		if(adcVal > 212)
 		{
 			searchlight_tmp = false;
@@ -78,13 +115,8 @@ void readDipSwitches()
 			randomDelay_tmp = true;
 		}
 
-		// Read ADC for timeout
-		wdt_reset();
-		ADMUX |= _BV(MUX2); //  ADC4 (PA5)
-		ADMUX &= ~(_BV(MUX1) | _BV(MUX0));
-		ADCSRA |= _BV(ADSC);  // Start the conversion
-		while(ADCSRA & _BV(ADSC));  // Wait for conversion to complete; no WD reset in case it takes too long
-		adcVal = ADCH;
+		// Timeout from the last background ADC sample
+		adcVal = adcTimeoutSample;
 		if(adcVal > 212)
 			timeoutSetting_tmp = 0;
 		else if(adcVal > 149)
@@ -100,6 +132,9 @@ void readDipSwitches()
 		searchlight =    getDebouncedState(&dipDebouncer) & 0x20;
 		randomDelay =    getDebouncedState(&dipDebouncer) & 0x10;
 		delaySetting =   getDebouncedState(&dipDebouncer) & 0xF;
+
+		// Refresh the ladder samples for the next pass
+		startOptionSampling();
 	} 
 }
 
@@ -128,47 +163,298 @@ bool isSearchlight(void)
 	return searchlight;
 }
 
+// Express mode - built with EXPRESS_ENABLE, fixed delays with the delay DIP
+//  at 0.  Otherwise that's the plain zero delay setting.
+bool isExpress(void)
+{
+#ifdef EXPRESS_ENABLE
+	return !randomDelay && (0 == delaySetting);
+#else
+	return false;
+#endif
+}
+
 // Inputs (bit / io / name):
 // Note: Approach B and Diamond labels are swapped on v1.2 hardware, fixed in code
 //  0 - PB4 - Approach B
 //  1 - PB5 - Diamond
 //  2 - PB6 - Approach A
 
+// Detector edges are caught by the pin change interrupt and queued with their
+//  time.  readInputs() works through the queue, handing each edge to a timed
+//  debouncer that's ticked every millisecond.  An input changes once it's
+//  been the other way, with no more edges, for its assert or release time -
+//  so the debounce runs from the last edge itself rather than being rounded
+//  up to a polling interval.
+// If the queue fills, the edges that didn't fit are dropped and the pins are
+//  read again when readInputs() gets to it.
+//
+// Built with INPUT_SHIFT_REGISTERS (hal.h), PB4 - PB6 drive a chain of
+//  74HC165s instead.  readInputs() shifts the whole chain in once a
+//  millisecond, so edges are only as good as that.  D0 - D2 of the first chip
+//  take the place of the three detectors above, with the same debounce; the
+//  rest get the four sample debounce (4ms) and are up to the application
+//  through getDetectorInputs().
+
+#define INPUT_CHANNELS           3
+#define INPUT_PINS               (_BV(PB4) | _BV(PB5) | _BV(PB6))
+#define INPUT_EDGE_QUEUE         8   // Power of two, 5 bytes each
+#define INPUT_APPROACHES         (_BV(0) | _BV(2))
+#define INPUT_DIAMOND            _BV(1)
+
+// Debounce times in milliseconds (1 - 255), override with -D for other
+//  detectors.  The release hold-over on the diamond rides out IR detectors
+//  that flicker between cars, so the interlocking doesn't drop into lockout
+//  with a train still on it.  Express mode cuts the approach assert time.
+#ifndef INPUT_APPROACH_ASSERT_MS
+#define INPUT_APPROACH_ASSERT_MS   10
+#endif
+#ifndef INPUT_APPROACH_RELEASE_MS
+#define INPUT_APPROACH_RELEASE_MS  25
+#endif
+#ifndef INPUT_DIAMOND_ASSERT_MS
+#define INPUT_DIAMOND_ASSERT_MS    10
+#endif
+#ifndef INPUT_DIAMOND_RELEASE_MS
+#define INPUT_DIAMOND_RELEASE_MS   200
+#endif
+#ifndef INPUT_EXPRESS_ASSERT_MS
+#define INPUT_EXPRESS_ASSERT_MS    3
+#endif
+
+#ifdef INPUT_SHIFT_REGISTERS
+
+#define INPUT_CHAIN_CHANNELS     (8 * INPUT_SHIFT_REGISTERS)
+#define INPUT_CHAIN_MASK         ((uint32_t)(((uint64_t)1 << INPUT_CHAIN_CHANNELS) - 1))
+
+static DebounceState32_t inputChainDebouncer;
+static uint32_t inputChainMillis;
+
+#else
+
+typedef struct
+{
+	uint32_t micros;
+	uint8_t pins;
+} InputEdge_t;
+
+static volatile InputEdge_t inputEdges[INPUT_EDGE_QUEUE];
+static volatile uint8_t inputEdgeHead, inputEdgeTail;
+static volatile bool inputEdgeOverflow;
+static uint8_t inputPinsLast;                      // Only touched by the ISR once it's on
+
+#endif
+
+static DebounceTimed8_t inputDebouncer;
+static uint32_t inputTickMillis;
+static uint32_t inputEdgeMicros[INPUT_CHANNELS];    // Last edge on each input
+static uint32_t inputChangeMicros[INPUT_CHANNELS];  // Edge the debounced state started with
+static uint32_t approachAssertMicros[2];
+
+#ifndef INPUT_SHIFT_REGISTERS
+ISR(PCINT_vect)
+{
+	uint8_t pins = halReadDetectorPins() & INPUT_PINS;
+	uint8_t next = (inputEdgeHead + 1) & (INPUT_EDGE_QUEUE - 1);
+
+	if (pins == inputPinsLast)
+		return;  // Back already
+	inputPinsLast = pins;
+
+	if (next == inputEdgeTail)
+	{
+		inputEdgeOverflow = true;
+		return;
+	}
+	inputEdges[inputEdgeHead].micros = getMicros();
+	inputEdges[inputEdgeHead].pins = pins;
+	inputEdgeHead = next;
+}
+
+// Detectors are active low
+static inline uint8_t inputPinsToState(uint8_t pins)
+{
+	return (~pins & INPUT_PINS) >> PB4;
+}
+#endif
+
+static void inputEdge(uint32_t micros, uint8_t raw)
+{
+	uint8_t changed = raw ^ inputDebouncer.raw;
+	uint8_t bit;
+
+	// Remember when each approach first showed up, before the debounce
+	uint8_t asserted = changed & raw & ~getDebouncedTimed8State(&inputDebouncer);
+	if (asserted & _BV(2))
+		approachAssertMicros[APPROACH_A] = micros;
+	if (asserted & _BV(0))
+		approachAssertMicros[APPROACH_B] = micros;
+
+	for (bit = 0; bit < INPUT_CHANNELS; bit++)
+		if (changed & _BV(bit))
+			inputEdgeMicros[bit] = micros;
+	debounceTimed8Input(&inputDebouncer, raw);
+}
+
+void initializeDetectors(void)
+{
+	uint32_t now = getMicros();
+	uint8_t bit;
+
+	initDebounceTimed8(&inputDebouncer, 0);
+	debounceTimed8SetTicks(&inputDebouncer, INPUT_APPROACHES, INPUT_APPROACH_ASSERT_MS, INPUT_APPROACH_RELEASE_MS);
+	debounceTimed8SetTicks(&inputDebouncer, INPUT_DIAMOND, INPUT_DIAMOND_ASSERT_MS, INPUT_DIAMOND_RELEASE_MS);
+	inputTickMillis = getMillis();
+
+	// Anything already occupied counts from now
+#ifdef INPUT_SHIFT_REGISTERS
+	uint32_t chain = ~halReadShiftInputs() & INPUT_CHAIN_MASK;
+	initDebounceState32(&inputChainDebouncer, chain);
+	inputChainMillis = inputTickMillis;
+	debounceTimed8Input(&inputDebouncer, chain & ((1 << INPUT_CHANNELS) - 1));
+#else
+	inputPinsLast = halReadDetectorPins() & INPUT_PINS;
+	debounceTimed8Input(&inputDebouncer, inputPinsToState(inputPinsLast));
+#endif
+	for (bit = 0; bit < INPUT_CHANNELS; bit++)
+		inputEdgeMicros[bit] = now;
+#ifndef INPUT_SHIFT_REGISTERS
+	halEnableDetectorInterrupt();
+#endif
+}
+
+void setExpressInputs(bool express)
+{
+	debounceTimed8SetTicks(&inputDebouncer, INPUT_APPROACHES,
+		express ? INPUT_EXPRESS_ASSERT_MS : INPUT_APPROACH_ASSERT_MS, INPUT_APPROACH_RELEASE_MS);
+}
+
 void readInputs()
 {
-	static uint32_t lastRead = 0;
-	uint32_t millisTemp;
-	uint8_t currentInputState = 0;
+	static uint8_t lastOccupancy = 0;
+	uint32_t now;
+	uint8_t changes, bit;
 
-	millisTemp = getMillis();
-	if ((millisTemp - lastRead) > 10)
+#ifdef INPUT_SHIFT_REGISTERS
+	now = getMillis();
+	if (now != inputChainMillis)
 	{
-		lastRead = millisTemp;
+		// Active low, like the detectors on the pins
+		uint32_t chain = ~halReadShiftInputs() & INPUT_CHAIN_MASK;
+		uint8_t raw = chain & ((1 << INPUT_CHANNELS) - 1);
 
-		currentInputState = ~( ((PINB & _BV(PB4))>>4) | ((PINB & _BV(PB5))>>4) | ((PINB & _BV(PB6))>>4) );
-		debounce8(currentInputState, &inputDebouncer);
-	} 
+		inputChainMillis = now;
+		if (raw != inputDebouncer.raw)
+			inputEdge(getMicros(), raw);
+		debounce32(chain, &inputChainDebouncer);
+	}
+#else
+	for (;;)
+	{
+		uint32_t micros = 0;
+		uint8_t pins = 0;
+		bool edge = false;
+
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			if (inputEdgeTail != inputEdgeHead)
+			{
+				micros = inputEdges[inputEdgeTail].micros;
+				pins = inputEdges[inputEdgeTail].pins;
+				inputEdgeTail = (inputEdgeTail + 1) & (INPUT_EDGE_QUEUE - 1);
+				edge = true;
+			}
+			else if (inputEdgeOverflow)
+			{
+				// Start over from the pins as they are now
+				inputEdgeOverflow = false;
+				inputPinsLast = halReadDetectorPins() & INPUT_PINS;
+				micros = getMicros();
+				pins = inputPinsLast;
+				edge = true;
+			}
+		}
+		if (!edge)
+			break;
+		inputEdge(micros, inputPinsToState(pins));
+	}
+#endif
+
+	// One debounce tick per millisecond, catching up after anything slow
+	now = getMillis();
+	if (now - inputTickMillis > 255)
+		inputTickMillis = now - 255;  // Every time has run out by then anyway
+	while (inputTickMillis != now)
+	{
+		inputTickMillis++;
+		changes = debounceTimed8Tick(&inputDebouncer);
+		for (bit = 0; bit < INPUT_CHANNELS; bit++)
+			if (changes & _BV(bit))
+				inputChangeMicros[bit] = inputEdgeMicros[bit];
+	}
+
+	uint8_t occupancy = blockOccupancy();
+	if (occupancy != lastOccupancy)
+	{
+		traceEvent(TRACE_INPUT, occupancy);
+		lastOccupancy = occupancy;
+	}
 }
 
-bool getInput(Block input)
+uint32_t getApproachAssertMicros(uint8_t direction)
+{
+	return approachAssertMicros[direction & 0x01];
+}
+
+static uint8_t inputBit(Block input)
 {
 	switch(input)
 	{
 		case APPROACH_A:
-			return( 0 != (getDebouncedState(&inputDebouncer) & _BV(2)) );
-			break;
+			return 2;
 		case APPROACH_B:
-			return( 0 != (getDebouncedState(&inputDebouncer) & _BV(0)) );
-			break;
+			return 0;
 		case DIAMOND:
-			return( 0 != (getDebouncedState(&inputDebouncer) & _BV(1)) );
-			break;
+			return 1;
 		default:
-			return false;
-			break;
+			return INPUT_CHANNELS;
 	}
 }
 
+bool getInput(Block input)
+{
+	return 0 != (getDebouncedTimed8State(&inputDebouncer) & _BV(inputBit(input)));
+}
+
+// getMicros() of the detector edge the input's debounced state started with
+uint32_t getInputChangeMicros(Block input)
+{
+	uint8_t bit = inputBit(input);
+	return (bit < INPUT_CHANNELS) ? inputChangeMicros[bit] : 0;
+}
+
+// Every debounced detector input, set for occupied.  Bits 0 - 2 are approach
+//  B, the diamond and approach A; with INPUT_SHIFT_REGISTERS the rest of the
+//  chain follows, input Dn of chip c in bit 8c + n.
+uint32_t getDetectorInputs(void)
+{
+	uint32_t inputs = getDebouncedTimed8State(&inputDebouncer);
+#ifdef INPUT_SHIFT_REGISTERS
+	inputs |= getDebouncedState32(&inputChainDebouncer) & ~(uint32_t)((1 << INPUT_CHANNELS) - 1);
+#endif
+	return inputs;
+}
+
+// Debounced occupancy of every block, as _BV(Block)
+uint8_t blockOccupancy(void)
+{
+	uint8_t inputState = getDebouncedTimed8State(&inputDebouncer);
+
+	return ((inputState & _BV(2)) ? _BV(APPROACH_A) : 0)
+		| ((inputState & _BV(0)) ? _BV(APPROACH_B) : 0)
+		| ((inputState & _BV(1)) ? _BV(DIAMOND) : 0);
+}
+
 bool approachBlockOccupancy(uint8_t direction)
 {
 	switch(direction)
@@ -190,6 +476,34 @@ bool interlockingBlockOccupancy(void)
 	return getInput(DIAMOND);
 }
 
+// Status LED
+// Bit-banging the WS2812 frame has interrupts off for ~30us and the part then
+//  needs ws2812_resettime of idle line before another frame.  Rather than stall
+//  in the main loop (and delay the PWM interrupt), setStatusLed() just queues
+//  the colour and the signal timer interrupt shifts it out in the gap after one
+//  of its own runs.
+
+#define STATUS_LED_HOLDOFF_CALLS  1  // Calls are >= 250us apart, skipping one covers the reset time
+
+static struct cRGB statusLed;
+static volatile bool statusLedPending = false;
+static uint8_t statusLedHoldoff = 0;
+
+void statusLedISR_Transmit(void)
+{
+	if (statusLedHoldoff)
+	{
+		statusLedHoldoff--;
+		return;
+	}
+
+	if (statusLedPending)
+	{
+		statusLedPending = false;
+		halStatusLedSend(&statusLed);
+		statusLedHoldoff = STATUS_LED_HOLDOFF_CALLS;
+	}
+}
 
 void setStatusLed(Status status)
 {
@@ -238,7 +552,11 @@ void setStatusLed(Status status)
 			case STATUS_UNKNOWN:
 				break;
 		}
-		ws2812_setleds(&led,1);
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			statusLed = led;
+			statusLedPending = true;
+		}
 		oldStatus = status;
 	}
 }
@@ -31,6 +31,7 @@ typedef enum
 } Status;
 
 extern uint32_t getMillis();
+extern uint32_t getMicros(void);
 
 void initializeInputOutput();
 void readDipSwitches();
@@ -39,12 +40,20 @@ uint8_t getDelaySetting();
 uint8_t getTimeoutSetting();
 bool isRandomized();
 bool isSearchlight();
+bool isExpress(void);
+void setExpressInputs(bool express);
+void initializeDetectors(void);
 void readInputs();
+uint32_t getApproachAssertMicros(uint8_t direction);
 bool getInput(Block input);
+uint32_t getInputChangeMicros(Block input);
+uint8_t blockOccupancy(void);
+uint32_t getDetectorInputs(void);
 bool approachBlockOccupancy(uint8_t direction);
 bool interlockingBlockOccupancy(void);
 
 void setStatusLed(Status status);
+void statusLedISR_Transmit(void);
 bool isCommonAnode(void);
 
 #endif
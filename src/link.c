@@ -0,0 +1,257 @@
+/*************************************************************************
+Title:    CKT-IIAB Board-to-Board Link
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     link.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+// Only built into the firmware with LINK_ENABLE
+#ifdef LINK_ENABLE
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "hal.h"
+#include "crc8.h"
+#include "link.h"
+#include "interlocking.h"
+#include "io.h"
+
+// What each of our routes runs into on either side.  Boards are chained the
+//  same way round, so the block between two of them is approach B of the
+//  first and approach A of the second.  Heading out through B, we need the
+//  neighbour not to be sending a train our way (its route B) or have one in
+//  its approach A.
+static const LinkConflict_t linkConflicts[LINK_PORTS][NUM_ROUTES] PROGMEM =
+{
+	// LINK_PORT_A
+	{
+		{ 0, 0 },                                   // ROUTE_APPROACH_A
+		{ _BV(ROUTE_APPROACH_A), _BV(APPROACH_B) }, // ROUTE_APPROACH_B
+	},
+	// LINK_PORT_B
+	{
+		{ _BV(ROUTE_APPROACH_B), _BV(APPROACH_A) }, // ROUTE_APPROACH_A
+		{ 0, 0 },                                   // ROUTE_APPROACH_B
+	},
+};
+
+typedef struct
+{
+	uint8_t rxBuffer[LINK_FRAME_BYTES];
+	uint8_t rxCount;
+	uint8_t rxErrors;       // Saturating
+
+	bool heard;
+	uint32_t lastHeard;
+	uint8_t node;           // Neighbour's last frame
+	uint8_t seq;
+	uint8_t ack;
+	uint8_t granted;
+	uint8_t requested;
+	uint8_t occupancy;
+
+	uint8_t txSeq;
+	uint8_t requestSeq;     // First of our frames carrying the current request
+	uint32_t lastSent;
+	uint8_t sentGranted;    // What the neighbour was last told
+	uint8_t sentRequested;
+	uint8_t sentOccupancy;
+	uint8_t sentAck;
+} LinkPort_t;
+
+static LinkPort_t linkPort[LINK_PORTS];
+static uint8_t linkNode;
+static uint8_t linkRequested;
+static uint32_t linkNow;
+
+void linkInitialize(uint8_t node)
+{
+	memset(linkPort, 0, sizeof(linkPort));
+	linkNode = node;
+	linkRequested = 0;
+	linkNow = 0;
+}
+
+bool linkAlive(uint8_t port)
+{
+	LinkPort_t* p = &linkPort[port];
+	return p->heard && (linkNow - p->lastHeard) < LINK_TIMEOUT_MS;
+}
+
+uint8_t linkErrors(uint8_t port)
+{
+	return linkPort[port].rxErrors;
+}
+
+static void linkReceiveByte(LinkPort_t* p, uint8_t data)
+{
+	uint8_t* frame = p->rxBuffer;
+	uint8_t skip;
+
+	if (0 == p->rxCount && LINK_SYNC != data)
+		return;
+
+	frame[p->rxCount++] = data;
+	if (p->rxCount < LINK_FRAME_BYTES)
+		return;
+
+	if (frame[LINK_FRAME_CRC] == crc8(frame + LINK_FRAME_NODE, LINK_FRAME_CRC - LINK_FRAME_NODE) && frame[LINK_FRAME_NODE] != linkNode)
+	{
+		p->heard = true;
+		p->lastHeard = linkNow;
+		p->node = frame[LINK_FRAME_NODE];
+		p->seq = frame[LINK_FRAME_SEQ];
+		p->ack = frame[LINK_FRAME_ACK];
+		p->granted = frame[LINK_FRAME_GRANTED];
+		p->requested = frame[LINK_FRAME_REQUESTED];
+		p->occupancy = frame[LINK_FRAME_OCCUPANCY];
+		p->rxCount = 0;
+		return;
+	}
+
+	// Bad frame (or our own, looped back) - pick up again at the next sync byte in it
+	if (p->rxErrors < 0xFF)
+		p->rxErrors++;
+	for (skip = 1; skip < LINK_FRAME_BYTES && LINK_SYNC != frame[skip]; skip++);
+	memmove(frame, frame + skip, LINK_FRAME_BYTES - skip);
+	p->rxCount = LINK_FRAME_BYTES - skip;
+}
+
+static void linkSendFrame(uint8_t port, LinkPort_t* p, uint8_t granted, uint8_t occupancy)
+{
+	uint8_t frame[LINK_FRAME_BYTES];
+	uint8_t i;
+
+	frame[LINK_FRAME_SYNC] = LINK_SYNC;
+	frame[LINK_FRAME_NODE] = linkNode;
+	frame[LINK_FRAME_SEQ] = ++p->txSeq;
+	frame[LINK_FRAME_ACK] = p->seq;
+	frame[LINK_FRAME_GRANTED] = granted;
+	frame[LINK_FRAME_REQUESTED] = linkRequested;
+	frame[LINK_FRAME_OCCUPANCY] = occupancy;
+	frame[LINK_FRAME_CRC] = crc8(frame + LINK_FRAME_NODE, LINK_FRAME_CRC - LINK_FRAME_NODE);
+
+	for (i = 0; i < LINK_FRAME_BYTES; i++)
+		halLinkSend(port, frame[i]);
+
+	p->lastSent = linkNow;
+	p->sentGranted = granted;
+	p->sentRequested = linkRequested;
+	p->sentOccupancy = occupancy;
+	p->sentAck = p->seq;
+}
+
+void linkUpdate(uint32_t now)
+{
+	uint8_t granted = grantedRoutes();
+	uint8_t occupancy = blockOccupancy();
+	uint8_t port, data;
+
+	linkNow = now;
+
+	for (port = 0; port < LINK_PORTS; port++)
+	{
+		LinkPort_t* p = &linkPort[port];
+
+		if (!halLinkConnected(port))
+			continue;
+
+		while (halLinkReceive(port, &data))
+			linkReceiveByte(p, data);
+
+		// A neighbour with a request open is waiting on our ack
+		bool changed = (granted != p->sentGranted) || (linkRequested != p->sentRequested) || (occupancy != p->sentOccupancy)
+			|| (p->requested && p->seq != p->sentAck);
+		uint32_t since = now - p->lastSent;
+
+		if ((since >= LINK_HEARTBEAT_MS || (changed && since >= LINK_MIN_GAP_MS)) && halLinkTxFree(port) >= LINK_FRAME_BYTES)
+			linkSendFrame(port, p, granted, occupancy);
+	}
+}
+
+// Polled by requestRoute() after the local checks pass.  Returns true once
+//  every neighbour the route depends on has agreed to it.
+bool linkRouteClear(uint8_t route)
+{
+	uint8_t bit = _BV(route);
+	bool clear = true;
+	uint8_t port;
+
+	for (port = 0; port < LINK_PORTS; port++)
+	{
+		LinkPort_t* p = &linkPort[port];
+		uint8_t routes = pgm_read_byte(&linkConflicts[port][route].routes);
+		uint8_t blocks = pgm_read_byte(&linkConflicts[port][route].blocks);
+
+		if (!halLinkConnected(port) || (0 == routes && 0 == blocks))
+			continue;
+
+		if (!linkAlive(port) || (p->granted & routes) || (p->occupancy & blocks))
+		{
+			// Neighbour down, or already using the shared block
+			linkRouteWithdraw(bit);
+			return false;
+		}
+
+		if (!(linkRequested & bit))
+		{
+			// Don't start a competing request, wait for the neighbour's to finish
+			if (p->requested & routes)
+				return false;
+			clear = false;
+			continue;
+		}
+
+		if ((int8_t)(p->ack - p->requestSeq) < 0)
+			clear = false;  // Neighbour hasn't seen the request yet
+		else if (p->requested & routes)
+		{
+			// Both asked at once
+			if (linkNode > p->node)
+			{
+				linkRouteWithdraw(bit);
+				return false;
+			}
+			clear = false;
+		}
+	}
+
+	if (clear)
+	{
+		linkRouteWithdraw(bit);
+		return true;
+	}
+
+	if (!(linkRequested & bit))
+	{
+		linkRequested |= bit;
+		for (port = 0; port < LINK_PORTS; port++)
+			linkPort[port].requestSeq = linkPort[port].txSeq + 1;
+	}
+	return false;
+}
+
+void linkRouteWithdraw(uint8_t routes)
+{
+	linkRequested &= ~routes;
+}
+
+#endif
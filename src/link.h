@@ -0,0 +1,83 @@
+/*************************************************************************
+Title:    CKT-IIAB Board-to-Board Link
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     link.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _LINK_H_
+#define _LINK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Chained interlockings share the block between them.  Neighbouring boards
+//  swap their state over a serial link (the HAL's halLink* byte transport) so
+//  neither clears a route into that block while the other holds one, or has
+//  a train in it.
+//
+// Every frame carries the whole state, so updates batch themselves:
+//  sync  node  seq  ack  granted  requested  occupancy  crc
+//  seq counts this side's frames, ack is the last seq heard from the other
+//  side, crc is CRC-8 (crc8.h) over node through occupancy.  A frame goes out
+//  whenever something in it changes (at most every LINK_MIN_GAP_MS) and at
+//  least every LINK_HEARTBEAT_MS.  A neighbour that hasn't been heard for
+//  LINK_TIMEOUT_MS is down, and any route that depends on it stays at stop.
+//
+// Routes are handed out with a request / answer exchange - a route is only
+//  clear once the neighbour has acked a frame carrying our request, and that
+//  answer shows it neither holds nor wants a conflicting route.  If both
+//  sides ask at once, the lower node number wins and the other backs off
+//  until the winner is done.
+
+#define LINK_PORT_A          0   // Neighbour beyond the approach A side
+#define LINK_PORT_B          1   // Neighbour beyond the approach B side
+#define LINK_PORTS           2
+
+#define LINK_SYNC            0xA5
+#define LINK_FRAME_BYTES     8
+#define LINK_MIN_GAP_MS      50    // 8 bytes is ~33ms at 2400 baud
+#define LINK_HEARTBEAT_MS    250
+#define LINK_TIMEOUT_MS      1000
+
+typedef enum
+{
+	LINK_FRAME_SYNC = 0,
+	LINK_FRAME_NODE,
+	LINK_FRAME_SEQ,
+	LINK_FRAME_ACK,
+	LINK_FRAME_GRANTED,
+	LINK_FRAME_REQUESTED,
+	LINK_FRAME_OCCUPANCY,
+	LINK_FRAME_CRC,
+} LinkFrameByte;
+
+typedef struct
+{
+	uint8_t routes;   // Neighbour's _BV(InterlockingRoute) that lead into the shared block
+	uint8_t blocks;   // Neighbour's _BV(Block) covering the shared block
+} LinkConflict_t;
+
+void linkInitialize(uint8_t node);
+void linkUpdate(uint32_t now);
+bool linkRouteClear(uint8_t route);
+void linkRouteWithdraw(uint8_t routes);
+bool linkAlive(uint8_t port);
+uint8_t linkErrors(uint8_t port);
+
+#endif
@@ -0,0 +1,49 @@
+/*************************************************************************
+Title:    Pseudo-Random Number Generator
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     prng.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include "prng.h"
+
+#define PRNG_DEFAULT_STATE  0x2545F491UL  // xorshift can't leave an all-zero state
+
+static uint32_t prngState = PRNG_DEFAULT_STATE;
+
+void prngSeed(uint32_t seed)
+{
+	prngState = seed ? seed : PRNG_DEFAULT_STATE;
+}
+
+// Stir more entropy into the current state without throwing away what's there
+void prngMix(uint32_t entropy)
+{
+	prngSeed(prngState ^ entropy);
+	prngNext();
+}
+
+uint32_t prngNext(void)
+{
+	uint32_t x = prngState;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	prngState = x;
+	return x;
+}
@@ -0,0 +1,35 @@
+/*************************************************************************
+Title:    Pseudo-Random Number Generator
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     prng.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _PRNG_H_
+#define _PRNG_H_
+
+#include <stdint.h>
+
+// xorshift32 - four bytes of state and nothing but shifts and XORs, which
+//  suits a part without a multiplier.  Not for anything cryptographic.
+
+void prngSeed(uint32_t seed);
+void prngMix(uint32_t entropy);
+uint32_t prngNext(void);
+
+#endif
@@ -26,18 +26,7 @@ LICENSE:
 #define MIN(a,b) ((a)<(b)?(a):(b))
 #define MAX(a,b) ((a)>(b)?(a):(b))
 
-/*
-
-typedef struct
-{
-	SignalAspect_t startAspect;
-	SignalAspect_t endAspect;
-	uint8_t phase;
-	uint8_t redPWM;
-	uint8_t yellowPWM;
-	uint8_t greenPWM;
-} SignalState_t;
-*/
+volatile bool signalHeadsChanged = false;
 
 void signalHeadInitialize(SignalState_t* sig)
 {
@@ -46,11 +35,16 @@ void signalHeadInitialize(SignalState_t* sig)
 	sig->redPWM = 0;
 	sig->yellowPWM = 0;
 	sig->greenPWM = 0;
+	sig->lunarPWM = 0;
 }
 
 void signalHeadAspectSet(SignalState_t* sig, SignalAspect_t aspect)
 {
-	sig->nextAspect = aspect;
+	if (sig->nextAspect != aspect)
+	{
+		sig->nextAspect = aspect;
+		signalHeadsChanged = true;
+	}
 }
 
 SignalAspect_t signalHeadAspectGet(SignalState_t* sig)
@@ -58,28 +52,134 @@ SignalAspect_t signalHeadAspectGet(SignalState_t* sig)
 	return sig->nextAspect;
 }
 
-void signalHeadISR_OutputPWM(SignalState_t* const sig, const uint8_t options, const uint8_t pwmPhase, 
-	volatile uint8_t* const redPort, const uint8_t redMask, volatile uint8_t* const yellowPort, 
-	const uint8_t yellowMask, volatile uint8_t* const greenPort, const uint8_t greenMask)
+// A head is steady when it isn't in a transition, doesn't have one waiting and
+//  isn't flashing, so each of its lamps is simply full on or off
+bool signalHeadIsSteady(SignalState_t* sig)
+{
+	SignalAspect_t aspect = sig->nextAspect;
+
+	if (aspect == ASPECT_FL_GREEN || aspect == ASPECT_FL_YELLOW || aspect == ASPECT_FL_RED)
+		return false;
+
+	if (sig->startAspect != sig->endAspect || sig->endAspect != aspect)
+		return false;
+
+	return (0 == sig->redPWM || 0x1F == sig->redPWM)
+		&& (0 == sig->yellowPWM || 0x1F == sig->yellowPWM)
+		&& (0 == sig->greenPWM || 0x1F == sig->greenPWM)
+		&& (0 == sig->lunarPWM || 0x1F == sig->lunarPWM);
+}
+
+void signalHeadPortTableInitialize(SignalPortTable_t* table, uint8_t portValue)
+{
+	uint8_t i, port;
+	for(port=0; port<SIGNAL_PORT_BYTES; port++)
+	{
+		table->onMask[port] = table->signalMask[port] = 0;
+		for(i=0; i<SIGNAL_PWM_PHASES; i++)
+			table->phase[i][port] = portValue;
+	}
+}
+
+// Building the port table is done in three steps once per frame:
+//  Begin clears it, PWMToPortTable is called for each head, and End turns it
+//  into finished port values.  While heads are being added, phase[n] holds the
+//  mask of lamps that turn off at phase n.  End then walks the phases once,
+//  dropping those lamps as it goes, so the cost doesn't depend on the number
+//  of heads or their PWM widths.
+// For Bit Angle Modulation, phase[n] is simply the lamps with bit n of their
+//  PWM value set.
+// Each port (byte) of the table is worked out on its own, so a head's lamps
+//  all have to be on the same one.
+
+void signalHeadISR_PortTableBegin(SignalPortTable_t* const table)
+{
+	uint8_t i, port;
+	for(port=0; port<SIGNAL_PORT_BYTES; port++)
+	{
+		table->onMask[port] = table->signalMask[port] = 0;
+		for(i=0; i<SIGNAL_PWM_PHASES; i++)
+			table->phase[i][port] = 0;
+	}
+}
+
+static inline void signalHeadISR_ChannelToPortTable(SignalPortTable_t* const table, const uint8_t port, const uint8_t pwm, const uint8_t mask)
+{
+	table->signalMask[port] |= mask;
+#ifdef SIGNAL_PWM_BAM
+	uint8_t i;
+	for(i=0; i<SIGNAL_PWM_PHASES; i++)
+	{
+		if (pwm & (1<<i))
+			table->phase[i][port] |= mask;
+	}
+#else
+	if (pwm)
+		table->onMask[port] |= mask;
+	table->phase[pwm & (SIGNAL_PWM_PHASES-1)][port] |= mask;
+#endif
+}
+
+// Steps every head of a PROGMEM descriptor table to its next PWM widths and
+//  adds its lamps to the table, all in the one pass
+void signalHeadISR_HeadsToPortTable(SignalState_t* const heads, const SignalHeadDef_t* const defs, const uint8_t count,
+	SignalPortTable_t* const table, const uint8_t flasher, const uint8_t options)
 {
-	bool invert = (options & SIGNAL_OPTION_COMMON_ANODE)?false:true;
-	if ((sig->redPWM > pwmPhase) != invert)
-		*redPort &= ~redMask;
-	else
-		*redPort |= redMask;
-
-	if ((sig->yellowPWM > pwmPhase) != invert)
-		*yellowPort &= ~yellowMask;
-	else
-		*yellowPort |= yellowMask;
-
-	if ((sig->greenPWM > pwmPhase) != invert)
-		*greenPort &= ~greenMask;
-	else
-		*greenPort |= greenMask;
+	uint8_t i;
+
+	for(i=0; i<count; i++)
+	{
+		SignalState_t* const sig = &heads[i];
+		const SignalHeadDef_t* const def = &defs[i];
+		uint8_t port = pgm_read_byte(&def->port);
+
+		signalHeadISR_AspectToNextPWM(sig, flasher,
+			(options & pgm_read_byte(&def->optionsKeep)) | pgm_read_byte(&def->optionsForce));
+
+		signalHeadISR_ChannelToPortTable(table, port, sig->redPWM, pgm_read_byte(&def->redMask));
+		signalHeadISR_ChannelToPortTable(table, port, sig->yellowPWM, pgm_read_byte(&def->yellowMask));
+		signalHeadISR_ChannelToPortTable(table, port, sig->greenPWM, pgm_read_byte(&def->greenMask));
+		signalHeadISR_ChannelToPortTable(table, port, sig->lunarPWM, pgm_read_byte(&def->lunarMask));
+	}
 }
 
+// Lamps that are driven some other way (hardware PWM) but share the port
+//  are held at their off level
+void signalHeadISR_LampsOffToPortTable(SignalPortTable_t* const table, const uint8_t port, const uint8_t mask)
+{
+	table->signalMask[port] |= mask;
+}
 
+void signalHeadISR_PortTableEnd(SignalPortTable_t* const table, const uint8_t options, const uint8_t portValue)
+{
+	uint8_t i, port;
+
+	for(port=0; port<SIGNAL_PORT_BYTES; port++)
+	{
+		// Common anode lamps are lit by driving the pin low
+		uint8_t invertMask = (options & SIGNAL_OPTION_COMMON_ANODE)?table->signalMask[port]:0;
+		uint8_t base = portValue & ~table->signalMask[port];
+
+#ifdef SIGNAL_PWM_BAM
+		for(i=0; i<SIGNAL_PWM_PHASES; i++)
+			table->phase[i][port] = base | (table->phase[i][port] ^ invertMask);
+#else
+		uint8_t on = table->onMask[port];
+
+		for(i=0; i<SIGNAL_PWM_PHASES; i++)
+		{
+			on &= ~table->phase[i][port];
+			table->phase[i][port] = base | (on ^ invertMask);
+		}
+#endif
+	}
+}
+#ifdef SIGNAL_PWM_TIMER1
+uint8_t signalHeadPWMToHardware(uint8_t pwm)
+{
+	return pgm_read_byte(&hardwarePWMLevels[pwm & 0x1F]);
+}
+#endif
 
 bool isGreenToYellow(SignalAspect_t startAspect, SignalAspect_t endAspect)
 {
@@ -97,9 +197,39 @@ bool isYellowToGreen(SignalAspect_t startAspect, SignalAspect_t endAspect)
 	return false;
 }
 
+// The lamp that shows an aspect gets the PWM width
+static inline void signalHeadAspectPWM(SignalState_t* sig, SignalAspect_t aspect, uint8_t pwm)
+{
+	switch(aspect)
+	{
+		case ASPECT_RED:
+		case ASPECT_FL_RED:
+			sig->redPWM = pwm;
+			break;
+
+		case ASPECT_YELLOW:
+		case ASPECT_FL_YELLOW:
+			sig->yellowPWM = pwm;
+			break;
+
+		case ASPECT_GREEN:
+		case ASPECT_FL_GREEN:
+			sig->greenPWM = pwm;
+			break;
+
+		case ASPECT_LUNAR:
+			sig->lunarPWM = pwm;
+			break;
+
+		default:
+			break;
+	}
+}
+
 void signalHeadISR_AspectToNextPWM(SignalState_t* sig, uint8_t flasher, uint8_t options)
 {
 	bool searchlightMode = (SIGNAL_OPTION_SEARCHLIGHT & options)?true:false;
+	bool expressMode = (SIGNAL_OPTION_EXPRESS & options)?true:false;
 	
 	SignalAspect_t signalAspect = sig->nextAspect;
 	
@@ -123,7 +253,9 @@ void signalHeadISR_AspectToNextPWM(SignalState_t* sig, uint8_t flasher, uint8_t
 		// For searchlights passing between any color and red (or vice versa), it's just a quick bounce as the roundels move - no fade
 		// For all other signals and searchlights going on or off, there's a fade in/out
 
-		if (searchlightMode && sig->startAspect != ASPECT_OFF && sig->endAspect != ASPECT_OFF)
+		// In express mode every transition is a short crossfade, so a clearing signal shows
+		//  its new colour on the very next frame
+		if (searchlightMode && !expressMode && sig->startAspect != ASPECT_OFF && sig->endAspect != ASPECT_OFF)
 		{
 			if (isGreenToYellow(sig->startAspect, sig->endAspect) || isYellowToGreen(sig->startAspect, sig->endAspect))
 			{
@@ -175,49 +307,9 @@ void signalHeadISR_AspectToNextPWM(SignalState_t* sig, uint8_t flasher, uint8_t
 				uint8_t upPhase = UP_PHASE(pwmWord);
 				uint8_t downPhase = DOWN_PHASE(pwmWord);
 
-				sig->redPWM = sig->yellowPWM = sig->greenPWM = 0;
-
-				switch(sig->startAspect)
-				{
-					case ASPECT_RED:
-					case ASPECT_FL_RED:
-						sig->redPWM = downPhase;
-						break;
-
-					case ASPECT_YELLOW:
-					case ASPECT_FL_YELLOW:
-						sig->yellowPWM = downPhase;
-						break;
-
-					case ASPECT_GREEN:
-					case ASPECT_FL_GREEN:
-						sig->greenPWM = downPhase;
-						break;
-
-					default:
-						break;
-				}
-
-				switch(sig->endAspect)
-				{
-					case ASPECT_RED:
-					case ASPECT_FL_RED:
-						sig->redPWM = upPhase;
-						break;
-
-					case ASPECT_YELLOW:
-					case ASPECT_FL_YELLOW:
-						sig->yellowPWM = upPhase;
-						break;
-
-					case ASPECT_GREEN:
-					case ASPECT_FL_GREEN:
-						sig->greenPWM = upPhase;
-						break;
-
-					default:
-						break;
-				}
+				sig->redPWM = sig->yellowPWM = sig->greenPWM = sig->lunarPWM = 0;
+				signalHeadAspectPWM(sig, sig->startAspect, downPhase);
+				signalHeadAspectPWM(sig, sig->endAspect, upPhase);
 
 				sig->phase++;
 				if (sig->phase >= sizeof(searchlightPWMsInvolvingRed)/sizeof(searchlightPWMsInvolvingRed[0]))
@@ -229,77 +321,49 @@ void signalHeadISR_AspectToNextPWM(SignalState_t* sig, uint8_t flasher, uint8_t
 			}
 			
 		} else {
-			uint16_t pwmWord = pgm_read_word(&fadePWMs[sig->phase]);
+			const uint16_t* fadeTable = fadePWMs;
+			uint8_t fadeLength = sizeof(fadePWMs)/sizeof(fadePWMs[0]);
+			if (expressMode)
+			{
+				fadeTable = expressFadePWMs;
+				fadeLength = sizeof(expressFadePWMs)/sizeof(expressFadePWMs[0]);
+			}
+
+			uint16_t pwmWord = pgm_read_word(&fadeTable[sig->phase]);
 			uint8_t upPhase = UP_PHASE(pwmWord);
 			uint8_t downPhase = DOWN_PHASE(pwmWord);
 
-			sig->redPWM = sig->yellowPWM = sig->greenPWM = 0;
+			sig->redPWM = sig->yellowPWM = sig->greenPWM = sig->lunarPWM = 0;
 			
-			switch(sig->startAspect)
+			if (ASPECT_OFF == sig->startAspect)
 			{
-				case ASPECT_RED:
-				case ASPECT_FL_RED:
-					sig->redPWM = downPhase;
-					break;
-
-				case ASPECT_YELLOW:
-				case ASPECT_FL_YELLOW:
-					sig->yellowPWM = downPhase;
-					break;
-
-				case ASPECT_GREEN:
-				case ASPECT_FL_GREEN:
-					sig->greenPWM = downPhase;
-					break;
-
-				case ASPECT_OFF:
-					// If we're going from off to on, go find the first entry
-					// where the upPhase is not zero and start from there
-					if (0 == upPhase)
+				// If we're going from off to on, go find the first entry
+				// where the upPhase is not zero and start from there
+				if (0 == upPhase)
+				{
+					do
 					{
-						do
-						{
-							pwmWord = pgm_read_word(&fadePWMs[++sig->phase]);
-							upPhase = UP_PHASE(pwmWord);
-						} while (upPhase == 0 && sig->phase < sizeof(fadePWMs)/sizeof(fadePWMs[0]));
-						sig->phase--;
-					}
-
-				default:
-					break;
+						pwmWord = pgm_read_word(&fadeTable[++sig->phase]);
+						upPhase = UP_PHASE(pwmWord);
+					} while (upPhase == 0 && sig->phase < fadeLength);
+					sig->phase--;
+				}
 			}
+			else
+				signalHeadAspectPWM(sig, sig->startAspect, downPhase);
 
-			switch(sig->endAspect)
+			if (ASPECT_OFF == sig->endAspect)
 			{
-				case ASPECT_RED:
-				case ASPECT_FL_RED:
-					sig->redPWM = upPhase;
-					break;
-
-				case ASPECT_YELLOW:
-				case ASPECT_FL_YELLOW:
-					sig->yellowPWM = upPhase;
-					break;
-
-				case ASPECT_GREEN:
-				case ASPECT_FL_GREEN:
-					sig->greenPWM = upPhase;
-					break;
-
-				case ASPECT_OFF:
-					// If we're going from something to off, we're done when we get the 
-					//  lamp completely off
-					if (downPhase == 0)
-						sig->phase = sizeof(fadePWMs)/sizeof(fadePWMs[0]);
-
-					break;
-
-				default:
-					break;
+				// If we're going from something to off, we're done when we get the 
+				//  lamp completely off
+				if (downPhase == 0)
+					sig->phase = fadeLength;
 			}
+			else
+				signalHeadAspectPWM(sig, sig->endAspect, upPhase);
 
 			sig->phase++;
-			if (sig->phase >= sizeof(fadePWMs)/sizeof(fadePWMs[0]))
+			if (sig->phase >= fadeLength)
 			{
 				// We're done
 				sig->phase = 0;
@@ -367,27 +431,8 @@ void signalHeadISR_AspectToNextPWM(SignalState_t* sig, uint8_t flasher, uint8_t
 	} else {
 		// We're at steady state and the signal isn't changing, so 
 		// just set the PWM based on the aspect for safety
-		sig->redPWM = sig->yellowPWM = sig->greenPWM = 0;
-		switch(sig->startAspect)
-		{
-			case ASPECT_RED:
-			case ASPECT_FL_RED:
-				sig->redPWM = 0x1F;
-				break;
-
-			case ASPECT_YELLOW:
-			case ASPECT_FL_YELLOW:
-				sig->yellowPWM = 0x1F;
-				break;
-
-			case ASPECT_GREEN:
-			case ASPECT_FL_GREEN:
-				sig->greenPWM = 0x1F;
-				break;
-
-			default:
-				break;
-		}
+		sig->redPWM = sig->yellowPWM = sig->greenPWM = sig->lunarPWM = 0;
+		signalHeadAspectPWM(sig, sig->startAspect, 0x1F);
 	}
 }
 
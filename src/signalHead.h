@@ -36,22 +36,77 @@ typedef struct
 	uint8_t redPWM;
 	uint8_t yellowPWM;
 	uint8_t greenPWM;
+	uint8_t lunarPWM;
 } SignalState_t;
 
+// Ready-made signal port values, one per software PWM phase, rebuilt once per
+//  frame so the PWM interrupt only has to do a single load and store
+// With Bit Angle Modulation (SIGNAL_PWM_BAM) there is one entry per PWM bit instead
+#ifdef SIGNAL_PWM_BAM
+#define SIGNAL_PWM_PHASES                  5
+#else
+#define SIGNAL_PWM_PHASES                  32
+#endif
+
+// One byte per port the lamps are on - PORTB, or each 74HC595 of the
+//  SIGNAL_OUTPUT_SHIFT_REGISTERS chain (hal.h)
+#ifdef SIGNAL_OUTPUT_SHIFT_REGISTERS
+#define SIGNAL_PORT_BYTES                  SIGNAL_OUTPUT_SHIFT_REGISTERS
+#else
+#define SIGNAL_PORT_BYTES                  1
+#endif
+
+typedef struct
+{
+	uint8_t onMask[SIGNAL_PORT_BYTES];
+	uint8_t signalMask[SIGNAL_PORT_BYTES];
+	uint8_t phase[SIGNAL_PWM_PHASES][SIGNAL_PORT_BYTES];
+} SignalPortTable_t;
+
 #define SIGNAL_OPTION_COMMON_ANODE         0x01
 #define SIGNAL_OPTION_SEARCHLIGHT          0x02
+#define SIGNAL_OPTION_EXPRESS              0x04
 
-#define SIGNAL_HEAD_INIT_STATE {ASPECT_OFF, ASPECT_OFF, 0, 0, 0, 0}
+#define SIGNAL_HEAD_INIT_STATE {ASPECT_OFF, ASPECT_OFF, ASPECT_OFF, 0, 0, 0, 0, 0}
+
+// Signal head descriptor, one per head in a PROGMEM table (see ckt-iiab.c)
+// Every lamp of a head is on the same port table byte.  A lamp the head
+//  doesn't have is a zero mask, and an aspect that needs it shows dark.
+// The head's options are the global ones (signalHeadOptions) masked with
+//  optionsKeep, plus optionsForce - fill both in with a SIGNAL_TYPE_*.
+typedef struct
+{
+	uint8_t port;
+	uint8_t redMask;
+	uint8_t yellowMask;
+	uint8_t greenMask;
+	uint8_t lunarMask;
+	uint8_t optionsKeep;
+	uint8_t optionsForce;
+} SignalHeadDef_t;
+
+#define SIGNAL_TYPE_JUMPER                 0xFF, 0                                      // Searchlight by the option jumper
+#define SIGNAL_TYPE_SEARCHLIGHT            0xFF, SIGNAL_OPTION_SEARCHLIGHT              // Always a searchlight
+#define SIGNAL_TYPE_LAMPS                  (uint8_t)~SIGNAL_OPTION_SEARCHLIGHT, 0       // Never a searchlight
+
+// Set by signalHeadAspectSet() whenever a head is asked for a new aspect
+extern volatile bool signalHeadsChanged;
 
 void signalHeadInitialize(SignalState_t* sig);
 void signalHeadAspectSet(SignalState_t* sig, SignalAspect_t aspect);
 SignalAspect_t signalHeadAspectGet(SignalState_t* sig);
+bool signalHeadIsSteady(SignalState_t* sig);
 
-void signalHeadISR_OutputPWM(SignalState_t* const sig, const uint8_t options, const uint8_t pwmPhase, 
-	volatile uint8_t* const redPort, const uint8_t redMask, volatile uint8_t* const yellowPort, 
-	const uint8_t yellowMask, volatile uint8_t* const greenPort, const uint8_t greenMask);
+void signalHeadPortTableInitialize(SignalPortTable_t* table, uint8_t portValue);
 
 void signalHeadISR_AspectToNextPWM(SignalState_t* sig, uint8_t flasher, uint8_t options);
+uint8_t signalHeadPWMToHardware(uint8_t pwm);
+
+void signalHeadISR_PortTableBegin(SignalPortTable_t* const table);
+void signalHeadISR_HeadsToPortTable(SignalState_t* const heads, const SignalHeadDef_t* const defs, const uint8_t count,
+	SignalPortTable_t* const table, const uint8_t flasher, const uint8_t options);
+void signalHeadISR_LampsOffToPortTable(SignalPortTable_t* const table, const uint8_t port, const uint8_t mask);
+void signalHeadISR_PortTableEnd(SignalPortTable_t* const table, const uint8_t options, const uint8_t portValue);
 
 #endif
 
@@ -153,5 +153,28 @@ const uint16_t const fadePWMs[] PROGMEM =
 	DRU_TO_UINT16(  0,  0, 31)
 };
 
+// Express mode crossfade - the old lamp fades out while the new one comes up,
+//  so the new colour is already lit on the first frame (8ms) of the change
+const uint16_t expressFadePWMs[] PROGMEM =
+{ 
+	DRU_TO_UINT16( 24,  0,  8),
+	DRU_TO_UINT16( 16,  0, 16),
+	DRU_TO_UINT16(  8,  0, 24),
+	DRU_TO_UINT16(  0,  0, 31)
+};
+
+#ifdef SIGNAL_PWM_TIMER1
+// 8-bit duty cycles for lamps on a hardware PWM channel, indexed by the 5-bit
+//  PWM level used everywhere else.  Linear, so a hardware lamp matches the
+//  software ones; this is the place to add a curve for finer low-end steps.
+const uint8_t hardwarePWMLevels[] PROGMEM =
+{
+	  0,   8,  16,  25,  33,  41,  49,  58,
+	 66,  74,  82,  90,  99, 107, 115, 123,
+	132, 140, 148, 156, 165, 173, 181, 189,
+	197, 206, 214, 222, 230, 239, 247, 255
+};
+#endif
+
 #endif
 
@@ -0,0 +1,153 @@
+/*************************************************************************
+Title:    CKT-IIAB Operating Statistics
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     stats.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "hal.h"
+#include "crc8.h"
+#include "eventLog.h"
+#include "stats.h"
+
+Stats_t stats;
+
+static const uint16_t statsDelayBucketMax[STATS_DELAY_BUCKETS - 1] PROGMEM = STATS_DELAY_BUCKET_MAX;
+
+static uint32_t statsLast;
+static uint8_t statsWrite = STATS_BYTES;   // Next byte to write, STATS_BYTES when idle
+static bool statsDirty;
+
+static inline void statsIncrement(uint16_t* counter)
+{
+	if (*counter < 0xFFFF)
+		(*counter)++;
+}
+
+static inline void statsChanged(void)
+{
+	statsDirty = true;
+}
+
+// Blocking reads, so call it before the main loop
+void statsInitialize(uint8_t resetCause)
+{
+	uint8_t* data = (uint8_t*)&stats;
+	uint8_t i;
+
+	for (i = 0; i < STATS_BYTES; i++)
+		data[i] = halEepromRead(EEPROM_STATS_ADDR + i);
+	if (STATS_VERSION != stats.version || crc8(data, STATS_BYTES - 1) != stats.crc)
+	{
+		memset(&stats, 0, sizeof(stats));
+		stats.delayBucketsSetting = STATS_DELAY_NONE;
+		stats.version = STATS_VERSION;
+	}
+
+	stats.resetCause = resetCause;
+	for (i = 0; i < STATS_RESET_CAUSES; i++)
+		if (resetCause & (1 << i))
+			statsIncrement(&stats.resets[i]);
+
+	// First snapshot a little after power up, so a reset loop doesn't wear the EEPROM
+	statsLast = 0 - (uint32_t)(STATS_SNAPSHOT_MS - STATS_BOOT_MS);
+	statsChanged();
+}
+
+uint8_t statsDelayBucket(uint32_t delaySeconds)
+{
+	uint8_t bucket;
+
+	for (bucket = 0; bucket < STATS_DELAY_BUCKETS - 1; bucket++)
+		if (delaySeconds <= pgm_read_word(&statsDelayBucketMax[bucket]))
+			break;
+	return bucket;
+}
+
+void statsTrain(uint8_t direction, uint8_t delaySetting, bool randomized, uint32_t delaySeconds)
+{
+	uint8_t setting = (delaySetting & (STATS_DELAY_SETTINGS - 1)) | (randomized ? STATS_DELAY_RANDOM : 0);
+
+	statsIncrement(&stats.trains[direction & 0x01]);
+	statsIncrement(&stats.delaySettingTrains[delaySetting & (STATS_DELAY_SETTINGS - 1)]);
+
+	// The histogram only holds one setting, start it over for a new one
+	if (setting != stats.delayBucketsSetting)
+	{
+		memset(stats.delayBuckets, 0, sizeof(stats.delayBuckets));
+		stats.delayBucketsSetting = setting;
+	}
+	statsIncrement(&stats.delayBuckets[statsDelayBucket(delaySeconds)]);
+	statsChanged();
+}
+
+void statsTimeout(void)
+{
+	statsIncrement(&stats.timeouts);
+	statsChanged();
+}
+
+void statsClearing(void)
+{
+	statsIncrement(&stats.clearings);
+	statsChanged();
+}
+
+void statsRequestWait(uint32_t milliseconds)
+{
+	if (milliseconds > stats.requestWaitMaxMs)
+	{
+		stats.requestWaitMaxMs = milliseconds;
+		statsChanged();
+	}
+}
+
+// Call from the main loop after eventLogUpdate().  Starts at most one EEPROM
+//  write, and only when the event log isn't using it.
+void statsUpdate(uint32_t now)
+{
+	uint8_t* data = (uint8_t*)&stats;
+
+	// Start a snapshot when one's due, or start over if the counters changed
+	//  part way through one
+	if (statsDirty && (STATS_BYTES != statsWrite || now - statsLast >= STATS_SNAPSHOT_MS))
+	{
+		stats.crc = crc8(data, STATS_BYTES - 1);
+		statsDirty = false;
+		statsLast = now;
+		statsWrite = 0;
+	}
+
+	if (halEepromBusy() || !eventLogIdle())
+		return;
+
+	while (statsWrite < STATS_BYTES)
+	{
+		uint8_t offset = statsWrite++;
+
+		if (halEepromRead(EEPROM_STATS_ADDR + offset) != data[offset])
+		{
+			halEepromWriteStart(EEPROM_STATS_ADDR + offset, data[offset]);
+			return;
+		}
+	}
+}
@@ -0,0 +1,88 @@
+/*************************************************************************
+Title:    CKT-IIAB Operating Statistics
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     stats.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "eepromMap.h"
+
+// Counters for tuning the timeout and lockout settings, kept across power
+//  cycles in EEPROM at EEPROM_STATS_ADDR.  Every counter saturates rather
+//  than wrapping.  Read them back with avrdude -U eeprom:r:eeprom.bin:r and
+//  run host/statsdump on it.
+//
+// The counters live in SRAM.  Once something has changed, a snapshot goes
+//  to EEPROM every STATS_SNAPSHOT_MS (the first STATS_BOOT_MS after power
+//  up), a byte per main loop pass while the event log has nothing to write.
+//  Only bytes that differ get written.  A power cut loses whatever happened since the last snapshot;
+//  one during a snapshot fails the CRC and the counters start over.
+//
+// The delay histogram is for one delay DIP setting at a time, not one per
+//  setting: 16 settings of STATS_DELAY_BUCKETS 16 bit buckets won't fit the
+//  EEPROM area.  It follows the setting (and the random switch) the trains
+//  run with, kept in delayBucketsSetting, and starts over when that changes.
+//  delaySettingTrains still counts every setting's trains.
+
+#define STATS_VERSION         2
+#define STATS_SNAPSHOT_MS     (15UL * 60 * 1000)
+#define STATS_BOOT_MS         (60UL * 1000)
+#define STATS_DELAY_SETTINGS  16
+#define STATS_DELAY_BUCKETS   8
+// Longest delay, in seconds, that goes in each bucket but the last
+#define STATS_DELAY_BUCKET_MAX  { 1, 5, 10, 20, 30, 60, 120 }
+#define STATS_DELAY_RANDOM    0x80 // In delayBucketsSetting, random delays
+#define STATS_DELAY_NONE      0xFF // In delayBucketsSetting, no trains yet
+#define STATS_RESET_CAUSES    4    // HAL_RESET_* bits, in order
+
+typedef struct
+{
+	uint32_t requestWaitMaxMs;                       // Longest wait in STATE_REQUEST for the interlocking
+	uint16_t trains[2];                              // Cycles started, by direction (APPROACH_A, APPROACH_B)
+	uint16_t delaySettingTrains[STATS_DELAY_SETTINGS];  // Cycles started, by delay DIP setting
+	uint16_t delayBuckets[STATS_DELAY_BUCKETS];      // Delays picked with delayBucketsSetting, by length
+	uint16_t timeouts;                               // STATE_TIMEOUT ran out without the train
+	uint16_t clearings;                              // STATE_CLEARING entered
+	uint16_t resets[STATS_RESET_CAUSES];             // Power-ups, by halResetCause() bit
+	uint8_t delayBucketsSetting;                     // Delay DIP setting, | STATS_DELAY_RANDOM, delayBuckets is for
+	uint8_t resetCause;                              // halResetCause() this time
+	uint8_t version;                                 // STATS_VERSION
+	uint8_t crc;                                     // crc8() of everything before it
+} Stats_t;
+
+#define STATS_BYTES           (offsetof(Stats_t, crc) + 1)
+
+_Static_assert(STATS_BYTES <= EEPROM_STATS_SIZE, "Statistics don't fit their EEPROM area");
+
+extern Stats_t stats;
+
+void statsInitialize(uint8_t resetCause);
+void statsTrain(uint8_t direction, uint8_t delaySetting, bool randomized, uint32_t delaySeconds);
+void statsTimeout(void);
+void statsClearing(void);
+void statsRequestWait(uint32_t milliseconds);
+void statsUpdate(uint32_t now);
+uint8_t statsDelayBucket(uint32_t delaySeconds);
+
+#endif
@@ -0,0 +1,121 @@
+/*************************************************************************
+Title:    CKT-IIAB Serial Telemetry
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     telemetry.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+// Only built into the firmware with TELEMETRY_ENABLE
+#ifdef TELEMETRY_ENABLE
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "hal.h"
+#include "io.h"
+#include "timers.h"
+#include "crc8.h"
+#include "telemetry.h"
+
+volatile uint16_t telemetryIsrCalls;
+volatile uint32_t telemetryIsrMicros;
+
+static uint32_t telemetryLast;
+static uint16_t telemetryLoops;
+static uint8_t telemetrySeq;
+
+void telemetryInitialize(void)
+{
+	halTelemetryInitialize();
+	telemetryLast = getMillis();
+	telemetryLoops = 0;
+	telemetrySeq = 0;
+}
+
+// Saturates rather than wrapping, a 16 bit field is over 100 minutes of tenths
+static uint16_t telemetryTenths(TimerId timer)
+{
+	uint32_t tenths = (timerRemaining(timer) + 99) / 100;
+	return (tenths > 0xFFFF) ? 0xFFFF : tenths;
+}
+
+static uint8_t telemetryPut(uint8_t crc, uint8_t data)
+{
+	halTelemetrySend(data);
+	return crc8Update(crc, data);
+}
+
+static uint8_t telemetryPut16(uint8_t crc, uint16_t data)
+{
+	crc = telemetryPut(crc, data);
+	return telemetryPut(crc, data >> 8);
+}
+
+// Scaled to a per second rate over the elapsed milliseconds
+static uint16_t telemetryRate(uint32_t count, uint32_t elapsed)
+{
+	uint32_t rate = (count * 1000 + elapsed / 2) / elapsed;
+	return (rate > 0xFFFF) ? 0xFFFF : rate;
+}
+
+void telemetryUpdate(uint32_t now, uint8_t state, uint8_t direction)
+{
+	uint32_t elapsed = now - telemetryLast;
+	uint16_t isrCalls;
+	uint32_t isrMicros;
+	uint8_t crc = 0;
+	uint8_t options;
+
+	telemetryLoops++;
+	if (elapsed < TELEMETRY_PERIOD_MS || halTelemetryTxFree() < TELEMETRY_FRAME_BYTES)
+		return;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		isrCalls = telemetryIsrCalls;
+		isrMicros = telemetryIsrMicros;
+		telemetryIsrCalls = 0;
+		telemetryIsrMicros = 0;
+	}
+
+	options = (isRandomized() ? TELEMETRY_OPT_RANDOM : 0)
+		| (isSearchlight() ? TELEMETRY_OPT_SEARCHLIGHT : 0)
+		| (isCommonAnode() ? TELEMETRY_OPT_COMMON_ANODE : 0)
+		| (isExpress() ? TELEMETRY_OPT_EXPRESS : 0)
+		| (getTimeoutSetting() << TELEMETRY_OPT_TIMEOUT_SHIFT);
+
+	crc = telemetryPut(crc, TELEMETRY_SYNC);
+	crc = telemetryPut(crc, telemetrySeq++);
+	crc = telemetryPut(crc, (direction << 4) | (state & 0x0F));
+	crc = telemetryPut(crc, blockOccupancy());
+	crc = telemetryPut(crc, getDipSetting());
+	crc = telemetryPut(crc, options);
+	crc = telemetryPut16(crc, telemetryTenths(TIMER_DELAY));
+	crc = telemetryPut16(crc, telemetryTenths(TIMER_TIMEOUT));
+	crc = telemetryPut16(crc, telemetryTenths(TIMER_LOCKOUT));
+	crc = telemetryPut16(crc, telemetryRate(telemetryLoops, elapsed));
+	crc = telemetryPut16(crc, telemetryRate(isrCalls, elapsed));
+	crc = telemetryPut16(crc, (isrMicros + elapsed / 2) / elapsed);  // us per ms is per mille
+	halTelemetrySend(crc);
+
+	telemetryLast = now;
+	telemetryLoops = 0;
+}
+
+#endif
@@ -0,0 +1,91 @@
+/*************************************************************************
+Title:    CKT-IIAB Serial Telemetry
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     telemetry.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stdint.h>
+#include "hal.h"
+
+// Status frames for TELEMETRY_ENABLE builds, sent every TELEMETRY_PERIOD_MS
+//  out the software UART (2400 baud 8N1, transmit only) for a logic
+//  analyser or USB serial adapter.  host/teledump decodes them.
+//
+// Frame, multi-byte fields little endian:
+//  0      TELEMETRY_SYNC
+//  1      sequence number
+//  2      (direction << 4) | InterlockState
+//  3      blockOccupancy()
+//  4      DIP switches (getDipSetting())
+//  5      TELEMETRY_OPT_* bits, timeout setting in bits 4-5
+//  6-7    delay remaining, tenths of a second
+//  8-9    timeout remaining, tenths of a second
+//  10-11  lockout remaining, tenths of a second
+//  12-13  main loop passes per second
+//  14-15  Timer0 interrupts per second
+//  16-17  time spent in the Timer0 interrupts, per mille
+//  18     CRC-8 (crc8.h) of bytes 0-17
+//
+// A frame is only started when it all fits in the transmit buffer, so a busy
+//  line drops whole frames and never sends part of one.  The interrupt
+//  figures come from TELEMETRY_ISR_BEGIN()/TELEMETRY_ISR_END() around the
+//  Timer0 handlers, read off the timer count, so they leave out the
+//  interrupt entry and exit.
+
+#define TELEMETRY_PERIOD_MS     250
+#define TELEMETRY_SYNC          0x5A
+#define TELEMETRY_FRAME_BYTES   19
+
+#define TELEMETRY_OPT_RANDOM        0x01
+#define TELEMETRY_OPT_SEARCHLIGHT   0x02
+#define TELEMETRY_OPT_COMMON_ANODE  0x04
+#define TELEMETRY_OPT_EXPRESS       0x08
+#define TELEMETRY_OPT_TIMEOUT_SHIFT 4
+
+#if TELEMETRY_FRAME_BYTES >= HAL_TELEMETRY_BUFFER && defined(TELEMETRY_ENABLE)
+#error "A telemetry frame has to fit in HAL_TELEMETRY_BUFFER"
+#endif
+
+#ifdef TELEMETRY_ENABLE
+
+extern volatile uint16_t telemetryIsrCalls;
+extern volatile uint32_t telemetryIsrMicros;
+
+// Put BEGIN first thing in the handler and END before every way out of it,
+//  with the microseconds per Timer0 count at the time
+#define TELEMETRY_ISR_BEGIN()          uint8_t telemetryIsrStart = halTimerCount()
+#define TELEMETRY_ISR_END(usPerCount)  do { telemetryIsrCalls++; telemetryIsrMicros += (uint8_t)(halTimerCount() - telemetryIsrStart) * (uint16_t)(usPerCount); } while(0)
+
+void telemetryInitialize(void);
+void telemetryUpdate(uint32_t now, uint8_t state, uint8_t direction);
+
+#else
+
+#define TELEMETRY_ISR_BEGIN()
+#define TELEMETRY_ISR_END(usPerCount)
+
+static inline void telemetryInitialize(void) {}
+static inline void telemetryUpdate(uint32_t now, uint8_t state, uint8_t direction) {}
+
+#endif
+
+#endif
@@ -0,0 +1,74 @@
+/*************************************************************************
+Title:    Deadline Timer Service
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     timers.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include "timers.h"
+#include "trace.h"
+
+static uint32_t timerNow;
+static uint32_t timerDeadline[NUM_TIMERS];
+static uint8_t timersRunning;
+
+void timersInitialize(void)
+{
+	timerNow = 0;
+	timersRunning = 0;
+}
+
+// Call once per pass through the main loop with the current millis
+void timersUpdate(uint32_t now)
+{
+	uint8_t i;
+
+	timerNow = now;
+	for(i=0; i<NUM_TIMERS; i++)
+	{
+		// Signed difference so this keeps working when millis wraps
+		if ((timersRunning & (1<<i)) && (int32_t)(now - timerDeadline[i]) >= 0)
+		{
+			timersRunning &= ~(1<<i);
+			traceEvent(TRACE_TIMER, i);
+		}
+	}
+}
+
+void timerStart(TimerId timer, uint32_t milliseconds)
+{
+	timerDeadline[timer] = timerNow + milliseconds;
+	timersRunning |= (1<<timer);
+}
+
+void timerStop(TimerId timer)
+{
+	timersRunning &= ~(1<<timer);
+}
+
+bool timerRunning(TimerId timer)
+{
+	return (timersRunning & (1<<timer)) != 0;
+}
+
+uint32_t timerRemaining(TimerId timer)
+{
+	if (!timerRunning(timer))
+		return 0;
+	return timerDeadline[timer] - timerNow;
+}
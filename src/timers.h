@@ -0,0 +1,49 @@
+/*************************************************************************
+Title:    Deadline Timer Service
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     timers.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _TIMERS_H_
+#define _TIMERS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Each timer is just a deadline against millis, so the ISR only has to count
+//  milliseconds.  Expiry is checked from the main loop by timersUpdate().
+// To add a timer, add it here (up to 8).
+
+typedef enum
+{
+	TIMER_DELAY = 0,
+	TIMER_TIMEOUT,
+	TIMER_LOCKOUT,
+	NUM_TIMERS
+} TimerId;
+
+void timersInitialize(void);
+void timersUpdate(uint32_t now);
+
+void timerStart(TimerId timer, uint32_t milliseconds);
+void timerStop(TimerId timer);
+bool timerRunning(TimerId timer);
+uint32_t timerRemaining(TimerId timer);
+
+#endif
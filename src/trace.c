@@ -0,0 +1,122 @@
+/*************************************************************************
+Title:    CKT-IIAB Event Trace
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     trace.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+// Only built into the firmware with TRACE_ENABLE
+#ifdef TRACE_ENABLE
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/wdt.h>
+#include <util/atomic.h>
+#include "hal.h"
+#include "io.h"
+#include "trace.h"
+
+#ifdef HOST_BUILD
+#define TRACE_NOINIT
+#else
+#define TRACE_NOINIT  __attribute__((section(".noinit")))
+#endif
+
+static TraceRecord_t traceBuffer[TRACE_ENTRIES] TRACE_NOINIT;
+static uint8_t traceHead TRACE_NOINIT;
+static uint8_t traceCount TRACE_NOINIT;
+static uint32_t traceLast TRACE_NOINIT;
+static uint16_t traceMagic TRACE_NOINIT;
+
+static uint16_t traceEepromAddr;
+
+static void traceEepromPut(uint8_t data)
+{
+	halEepromWrite(traceEepromAddr++, data);
+	wdt_reset();
+}
+
+// Run before interrupts are on
+void traceInitialize(void)
+{
+	// Anything but a power-on leaves the last run's trace behind
+	if (TRACE_MAGIC == traceMagic && traceHead < TRACE_ENTRIES && traceCount <= TRACE_ENTRIES)
+	{
+		traceEepromAddr = TRACE_EEPROM_ADDR;
+		traceDump(traceEepromPut);
+	}
+
+	traceMagic = TRACE_MAGIC;
+	traceHead = 0;
+	traceCount = 0;
+	traceLast = 0;
+	traceEvent(TRACE_BOOT, 0);
+}
+
+static inline void tracePut(uint8_t delta, uint8_t event, uint8_t payload)
+{
+	TraceRecord_t* r = &traceBuffer[traceHead];
+
+	r->delta = delta;
+	r->event = event;
+	r->payload = payload;
+	traceHead = (traceHead + 1) & (TRACE_ENTRIES - 1);
+	if (traceCount < TRACE_ENTRIES)
+		traceCount++;
+}
+
+void traceEvent(uint8_t event, uint8_t payload)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		uint32_t now = getMillis();
+		uint32_t delta = now - traceLast;
+
+		traceLast = now;
+		if (delta > 0xFF)
+		{
+			if (delta > 0xFFFFFF)
+				delta = 0xFFFFFF;
+			tracePut(delta >> 8, TRACE_GAP, delta >> 16);
+		}
+		tracePut(delta, event, payload);
+	}
+}
+
+void traceDump(void (*put)(uint8_t data))
+{
+	uint8_t i, index;
+
+	put(TRACE_DUMP_ID);
+	put(TRACE_ENTRIES);
+	put(traceCount);
+	put(0);
+	for (i = 0; i < 32; i += 8)
+		put(traceLast >> i);
+
+	index = (traceHead - traceCount) & (TRACE_ENTRIES - 1);
+	for (i = 0; i < traceCount; i++)
+	{
+		put(traceBuffer[index].delta);
+		put(traceBuffer[index].event);
+		put(traceBuffer[index].payload);
+		index = (index + 1) & (TRACE_ENTRIES - 1);
+	}
+}
+
+#endif
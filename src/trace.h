@@ -0,0 +1,86 @@
+/*************************************************************************
+Title:    CKT-IIAB Event Trace
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     trace.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2024 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+#include "hal.h"
+#include "eepromMap.h"
+
+// Flight recorder for TRACE_ENABLE builds - the last TRACE_ENTRIES state
+//  changes, input edges, aspect changes and timer expirations, in SRAM.
+//
+// Each record is three bytes: milliseconds since the record before it, the
+//  event and its payload.  Longer gaps get a TRACE_GAP record first, holding
+//  bits 8-15 of the gap in its delta byte and bits 16-23 in its payload.
+//
+// The buffer lives in .noinit, so it's still there after a watchdog, brown-
+//  out or external reset.  traceInitialize() spots that and copies it to
+//  EEPROM at TRACE_EEPROM_ADDR before starting over.  Read it back with
+//  avrdude -U eeprom:r:eeprom.bin:r and run host/tracedump on it.
+
+#define TRACE_ENTRIES        32    // Power of two, 3 bytes of SRAM each
+#define TRACE_MAGIC          0x7A3C
+
+// Dump: 'T', TRACE_ENTRIES, record count, 0, millis of the newest record
+//  (32 bit little endian), then the records oldest first
+#define TRACE_DUMP_ID        'T'
+#define TRACE_DUMP_HEADER    8
+#define TRACE_DUMP_BYTES     (TRACE_DUMP_HEADER + 3 * TRACE_ENTRIES)
+#define TRACE_EEPROM_ADDR    EEPROM_TRACE_ADDR
+
+#if TRACE_DUMP_BYTES > EEPROM_TRACE_SIZE
+#error "Trace dump doesn't fit its EEPROM area"
+#endif
+
+typedef enum
+{
+	TRACE_GAP = 0,
+	TRACE_BOOT,       // Payload 0
+	TRACE_STATE,      // (direction << 4) | InterlockState
+	TRACE_INPUT,      // blockOccupancy()
+	TRACE_ASPECT,     // (head A aspect << 4) | head B aspect
+	TRACE_TIMER,      // TimerId that expired
+} TraceEvent;
+
+typedef struct
+{
+	uint8_t delta;
+	uint8_t event;
+	uint8_t payload;
+} TraceRecord_t;
+
+#ifdef TRACE_ENABLE
+
+void traceInitialize(void);
+void traceEvent(uint8_t event, uint8_t payload);
+void traceDump(void (*put)(uint8_t data));
+
+#else
+
+static inline void traceInitialize(void) {}
+static inline void traceEvent(uint8_t event, uint8_t payload) {}
+
+#endif
+
+#endif